@@ -0,0 +1,137 @@
+#!/bin/bash
+# Benchmark suite for the simulator, run by "make bench".
+#
+# Runs a fixed set of workloads (superfastgrowingis r, fastgrowingpg k
+# through pg2is, and every example file), reads the phase times and peak
+# memory reported by simulator --stats, and writes one CSV row per workload
+# to bench.csv. If bench-baseline.csv exists, each workload is compared
+# against it and slowdowns beyond the tolerance are reported.
+#
+# Usage: ./bench.sh [--save]
+#   --save   also copy the results to bench-baseline.csv
+#
+# Environment:
+#   BENCH_RUNS       runs per workload, the fastest is kept (default 3)
+#   BENCH_TOLERANCE  allowed slowdown or memory growth in percent (default 10)
+#   BENCH_FLAGS      extra simulator flags, to compare engine variants
+#
+# Insertion counts come from the search counters of a "make STATS=1"
+# build; otherwise they are derived from the polymer sizes, which
+# undercounts the shared prefixes of ambiguous systems.
+
+RUNS=${BENCH_RUNS:-3}
+TOLERANCE=${BENCH_TOLERANCE:-10}
+RESULTS=bench.csv
+BASELINE=bench-baseline.csv
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Workloads whose baseline simulation takes less than this are too noisy
+# to compare.
+MIN_SECONDS=0.005
+
+# Prints the wall time of phase $2 in the --stats output $1.
+phase_seconds() {
+	grep "\"name\": \"$2\"" "$1" | sed 's/.*"wall_seconds": \([0-9.]*\).*/\1/'
+}
+
+# Simulates the insertion system in file $2 as workload $1, with the
+# simulator flags $3 (default -s, printing only the polymer sizes).
+run() {
+	local name=$1 input=$2 flags=${3:--s}
+	local bytes=$(wc -c < "$input")
+	local best_sim= best_parse= rss=0
+	for ((i = 0; i < RUNS; ++i)); do
+		./simulator $flags --stats $BENCH_FLAGS < "$input" > "$TMP/out" 2> "$TMP/stats" || {
+			echo "$name: skipped, simulator failed: $(grep -v '^[ {}\]"]' "$TMP/stats" | head -1)" >&2
+			return
+		}
+		local sim=$(phase_seconds "$TMP/stats" simulate)
+		local parse=$(phase_seconds "$TMP/stats" parse)
+		local r=$(sed -n 's/.*"peak_rss_kb": \([0-9]*\).*/\1/p' "$TMP/stats")
+		if [ -z "$best_sim" ] || awk "BEGIN { exit !($sim < $best_sim) }"; then
+			best_sim=$sim
+		fi
+		if [ -z "$best_parse" ] || awk "BEGIN { exit !($parse < $best_parse) }"; then
+			best_parse=$parse
+		fi
+		[ "$r" -gt "$rss" ] && rss=$r
+	done
+
+	local polymers=$(grep -c "^Polymer size:" "$TMP/out")
+	local monomers=$(awk '/^Polymer size:/ { n += $3 } END { printf "%d", n }' "$TMP/out")
+	local insertions=$(sed -n 's/.*"insertions": \([0-9]*\).*/\1/p' "$TMP/stats")
+	[ -z "$insertions" ] && insertions=$((monomers - 2 * polymers))
+
+	awk -v name="$name" -v bytes="$bytes" -v polymers="$polymers" -v monomers="$monomers" \
+		-v insertions="$insertions" -v sim="$best_sim" -v parse="$best_parse" -v rss="$rss" \
+		'function rate(n, t) { return t > 0 ? n / t : 0 }
+		BEGIN {
+			printf "%s,%d,%d,%d,%d,%.6f,%.0f,%.0f,%.6f,%.2f,%d\n", name, bytes, polymers,
+				monomers, insertions, sim, rate(insertions, sim), rate(monomers, sim),
+				parse, rate(bytes, parse) / 1e6, rss
+		}' >> "$RESULTS"
+}
+
+echo "workload,input_bytes,polymers,monomers,insertions,simulate_seconds,insertions_per_second,monomers_per_second,parse_seconds,parse_mb_per_second,peak_rss_kb" > "$RESULTS"
+
+for r in 1 2; do
+	./superfastgrowingis $r > "$TMP/in"
+	run "superfastgrowingis-$r" "$TMP/in"
+done
+for k in 4 8 12 16; do
+	./fastgrowingpg $k | ./pg2is > "$TMP/in"
+	run "fastgrowingpg-$k" "$TMP/in"
+done
+# A large system whose polymer is only measured (-c), for parse throughput
+./fastgrowingpg 3000 | ./pg2is > "$TMP/in"
+run "fastgrowingpg-3000-count" "$TMP/in" -c
+for f in examples/is-*.txt; do
+	run "$(basename "$f" .txt)" "$f"
+done
+for f in examples/pg-*.txt; do
+	./pg2is < "$f" > "$TMP/in"
+	run "$(basename "$f" .txt)" "$TMP/in"
+done
+for f in examples/g-*.txt; do
+	./g2pg < "$f" | ./pg2is > "$TMP/in"
+	run "$(basename "$f" .txt)" "$TMP/in"
+done
+
+if command -v column > /dev/null; then
+	column -s, -t < "$RESULTS"
+else
+	cat "$RESULTS"
+fi
+
+if [ "$1" = "--save" ]; then
+	cp "$RESULTS" "$BASELINE"
+	echo "Saved baseline to $BASELINE"
+	exit 0
+fi
+[ -f "$BASELINE" ] || exit 0
+
+# Compares the simulation time and peak memory of each workload with the
+# baseline, and fails if any is worse by more than the tolerance.
+echo
+echo "Compared with $BASELINE (tolerance $TOLERANCE%):"
+awk -F, -v tol="$TOLERANCE" -v min="$MIN_SECONDS" '
+	FNR == 1 { next }
+	NR == FNR { sim[$1] = $6; rss[$1] = $11; next }
+	!($1 in sim) { printf "  %-24s new workload\n", $1; next }
+	{
+		status = "ok"
+		if (sim[$1] >= min && $6 > sim[$1] * (1 + tol / 100)) {
+			status = "SLOWER"
+			failed = 1
+		}
+		if ($11 > rss[$1] * (1 + tol / 100)) {
+			status = (status == "ok" ? "MORE MEMORY" : status ", MORE MEMORY")
+			failed = 1
+		}
+		printf "  %-24s time %+7.1f%%  memory %+7.1f%%  %s\n", $1,
+			(sim[$1] > 0 ? 100 * ($6 / sim[$1] - 1) : 0),
+			(rss[$1] > 0 ? 100 * ($11 / rss[$1] - 1) : 0),
+			(sim[$1] >= min ? status : status " (too short to time)")
+	}
+	END { exit failed }' "$BASELINE" "$RESULTS"
@@ -0,0 +1,112 @@
+
+#include "bigint.h"
+#include <algorithm>
+
+BigInt :: BigInt() {
+}
+
+BigInt :: BigInt(unsigned long long n) {
+	while (n != 0) {
+		digits.push_back((unsigned int) n);
+		n >>= 32;
+	}
+}
+
+void BigInt :: trim() {
+	while (!digits.empty() && digits.back() == 0)
+		digits.pop_back();
+}
+
+bool BigInt :: is_zero() const {
+	return digits.empty();
+}
+
+bool BigInt :: fits_u64() const {
+	return digits.size() <= 2;
+}
+
+unsigned long long BigInt :: u64() const {
+	unsigned long long n = 0;
+	for (int i = std::min((int) digits.size(), 2) - 1; i >= 0; --i)
+		n = (n << 32) | digits[i];
+	return n;
+}
+
+string BigInt :: str() const {
+	if (is_zero())
+		return "0";
+
+	// Repeatedly divide by 10^9, collecting 9 decimal digits at a time
+	vector<unsigned int> n = digits;
+	string s;
+	while (!n.empty()) {
+		unsigned long long rem = 0;
+		for (int i = n.size() - 1; i >= 0; --i) {
+			unsigned long long cur = (rem << 32) | n[i];
+			n[i] = (unsigned int) (cur / 1000000000);
+			rem = cur % 1000000000;
+		}
+		while (!n.empty() && n.back() == 0)
+			n.pop_back();
+		for (int i = 0; i < 9 && (!n.empty() || rem != 0); ++i) {
+			s.push_back('0' + rem % 10);
+			rem /= 10;
+		}
+	}
+	reverse(s.begin(), s.end());
+	return s;
+}
+
+BigInt& BigInt :: operator+=(const BigInt& n) {
+	if (digits.size() < n.digits.size())
+		digits.resize(n.digits.size(), 0);
+	unsigned long long carry = 0;
+	for (unsigned int i = 0; i < digits.size(); ++i) {
+		carry += (unsigned long long) digits[i] + (i < n.digits.size() ? n.digits[i] : 0);
+		digits[i] = (unsigned int) carry;
+		carry >>= 32;
+		if (carry == 0 && i >= n.digits.size())
+			break;
+	}
+	if (carry != 0)
+		digits.push_back((unsigned int) carry);
+	return *this;
+}
+
+BigInt BigInt :: operator+(const BigInt& n) const {
+	BigInt sum = *this;
+	sum += n;
+	return sum;
+}
+
+BigInt BigInt :: operator*(const BigInt& n) const {
+	BigInt product;
+	if (is_zero() || n.is_zero())
+		return product;
+	product.digits.assign(digits.size() + n.digits.size(), 0);
+	for (unsigned int i = 0; i < digits.size(); ++i) {
+		unsigned long long carry = 0;
+		for (unsigned int j = 0; j < n.digits.size(); ++j) {
+			carry += (unsigned long long) digits[i] * n.digits[j] + product.digits[i+j];
+			product.digits[i+j] = (unsigned int) carry;
+			carry >>= 32;
+		}
+		product.digits[i + n.digits.size()] = (unsigned int) carry;
+	}
+	product.trim();
+	return product;
+}
+
+bool BigInt :: operator<(const BigInt& n) const {
+	if (digits.size() != n.digits.size())
+		return digits.size() < n.digits.size();
+	for (int i = digits.size() - 1; i >= 0; --i)
+		if (digits[i] != n.digits[i])
+			return digits[i] < n.digits[i];
+	return false;
+}
+
+bool BigInt :: operator==(const BigInt& n) const {
+	return digits == n.digits;
+}
+
@@ -0,0 +1,36 @@
+
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Arbitrary precision non-negative integers, for counts and lengths
+// that outgrow 64 bits (e.g. polymer lengths of 2^Theta(r^3)).
+class BigInt {
+
+	public:
+		BigInt();
+		BigInt(unsigned long long n);
+
+		bool is_zero() const;
+		bool fits_u64() const;
+		unsigned long long u64() const;
+		string str() const;
+
+		BigInt& operator+=(const BigInt& n);
+		BigInt operator+(const BigInt& n) const;
+		BigInt operator*(const BigInt& n) const;
+		bool operator<(const BigInt& n) const;
+		bool operator==(const BigInt& n) const;
+
+	private:
+		void trim();
+		vector<unsigned int> digits; /* base 2^32, least significant first */
+};
+
+#endif
+
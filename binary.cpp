@@ -0,0 +1,166 @@
+
+#include "binary.h"
+#include "parser.h"
+#include <climits>
+#include <cstring>
+#include <string>
+
+using std::string;
+using std::to_string;
+
+static const char MAGIC[4] = {'I', 'N', 'S', 'B'};
+
+unsigned long long get_u64(const char* p) {
+	const unsigned char* u = (const unsigned char*) p;
+	unsigned long long v = 0;
+	for (int i = 7; i >= 0; --i)
+		v = (v << 8) | u[i];
+	return v;
+}
+
+void put_u64(char* p, unsigned long long v) {
+	for (int i = 0; i < 8; ++i)
+		p[i] = (char) (v >> (8 * i));
+}
+
+double get_f64(const char* p) {
+	unsigned long long v = get_u64(p);
+	double x;
+	memcpy(&x, &v, sizeof(x));
+	return x;
+}
+
+void put_f64(char* p, double x) {
+	unsigned long long v;
+	memcpy(&v, &x, sizeof(v));
+	put_u64(p, v);
+}
+
+bool is_binary(Parser& parser) {
+	return parser.bytes_left() >= sizeof(MAGIC) && memcmp(parser.bytes(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+static string kind_name(char kind) {
+	switch (kind) {
+		case 'g': return "grammar";
+		case 'p': return "pair grammar";
+		case 's': return "insertion system";
+		default: return string("unknown kind '") + kind + "'";
+	}
+}
+
+const char* read_binary_header(Parser& parser, char kind, int record_size, BinaryHeader& header) {
+	const char* p = parser.bytes();
+	size_t size = parser.bytes_left();
+	if (size < (size_t) BINARY_HEADER_SIZE) {
+		parser.fail_at(p + size, "binary header is truncated");
+		return NULL;
+	}
+
+	header.kind = p[4];
+	header.record_size = (unsigned char) p[6] | ((unsigned char) p[7] << 8);
+	header.records = get_u64(p + 8);
+	header.min_symbol = get_i32(p + 16);
+	header.max_symbol = get_i32(p + 20);
+	for (int i = 0; i < 4; ++i)
+		header.start[i] = get_i32(p + 24 + 4 * i);
+	header.flags = get_i32(p + 40);
+
+	if (header.kind != kind) {
+		parser.fail_at(p + 4, "expected a binary " + kind_name(kind) + ", found a " + kind_name(header.kind));
+		return NULL;
+	}
+	if (p[5] != BINARY_VERSION) {
+		parser.fail_at(p + 5, "unsupported binary format version " + to_string((int) (unsigned char) p[5]));
+		return NULL;
+	}
+	if (header.record_size != record_size) {
+		parser.fail_at(p + 6, "record size " + to_string(header.record_size) + ", expected " + to_string(record_size));
+		return NULL;
+	}
+
+	size_t available = (size - BINARY_HEADER_SIZE) / record_size;
+	if (header.records == BINARY_UNKNOWN_RECORDS) {
+		if ((size - BINARY_HEADER_SIZE) % record_size != 0) {
+			parser.fail_at(p + BINARY_HEADER_SIZE + available * record_size, "last record is truncated");
+			return NULL;
+		}
+		header.records = available;
+	}
+	else if (header.records > available) {
+		parser.fail_at(p + size, "expected " + to_string(header.records) + " records, found " + to_string(available));
+		return NULL;
+	}
+	return p + BINARY_HEADER_SIZE;
+}
+
+BinaryWriter :: BinaryWriter(FILE* f, char kind, int record_size) {
+	this->f = f;
+	header.kind = kind;
+	header.record_size = record_size;
+	header.records = BINARY_UNKNOWN_RECORDS;
+	header.min_symbol = INT_MAX;
+	header.max_symbol = INT_MIN;
+	for (int i = 0; i < 4; ++i)
+		header.start[i] = 0;
+	header.flags = 0;
+	started = false;
+	header_offset = -1;
+	written = 0;
+}
+
+void BinaryWriter :: set_start(const int start[4], unsigned int flags) {
+	for (int i = 0; i < 4; ++i)
+		header.start[i] = start[i];
+	header.flags = flags;
+}
+
+void BinaryWriter :: set_records(unsigned long long records) {
+	header.records = records;
+}
+
+void BinaryWriter :: write_header() {
+	char h[BINARY_HEADER_SIZE] = {0};
+	memcpy(h, MAGIC, sizeof(MAGIC));
+	h[4] = header.kind;
+	h[5] = BINARY_VERSION;
+	h[6] = (char) header.record_size;
+	h[7] = (char) (header.record_size >> 8);
+	put_u64(h + 8, header.records);
+	put_i32(h + 16, header.min_symbol);
+	put_i32(h + 20, header.max_symbol);
+	for (int i = 0; i < 4; ++i)
+		put_i32(h + 24 + 4 * i, header.start[i]);
+	put_i32(h + 40, header.flags);
+	fwrite(h, 1, sizeof(h), f);
+}
+
+void BinaryWriter :: write(const char* record, int min_symbol, int max_symbol) {
+	if (!started) {
+		// The range is filled in by finish(), if the output can seek back
+		header_offset = ftell(f);
+		write_header();
+		started = true;
+	}
+	fwrite(record, 1, header.record_size, f);
+	++written;
+	if (min_symbol < header.min_symbol)
+		header.min_symbol = min_symbol;
+	if (max_symbol > header.max_symbol)
+		header.max_symbol = max_symbol;
+}
+
+bool BinaryWriter :: finish() {
+	if (!started) {
+		header.records = 0;
+		write_header();
+		started = true;
+	}
+	else if (header_offset >= 0 && fseek(f, header_offset, SEEK_SET) == 0) {
+		header.records = written;
+		write_header();
+		fseek(f, 0, SEEK_END);
+	}
+	return fflush(f) == 0 && !ferror(f);
+}
+
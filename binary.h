@@ -0,0 +1,111 @@
+
+#ifndef BINARY_H
+#define BINARY_H
+
+#include <cstddef>
+#include <cstdio>
+
+// Binary interchange format for grammars, pair grammars and insertion
+// systems, read by g2pg, pg2is and simulator in place of text and written
+// by them and the generators with -b. A file is a 64-byte header followed
+// by fixed-width records, all little-endian, so a mapped file can be read
+// in place:
+//
+//   offset  size  header field
+//   0       4     "INSB"
+//   4       1     kind: 'g' grammar, 'p' pair grammar, 's' insertion system
+//   5       1     version, 1
+//   6       2     record size in bytes
+//   8       8     number of records, or all ones if they run to the end of the input
+//   16      4     smallest symbol in the records (smallest > largest if unknown)
+//   20      4     largest symbol
+//   24      16    4 x 4: the grammar's start symbol, the pair grammar's start
+//                 symbol (a, d), or the insertion system's initiator (c, d) (a, b)
+//   40      4     flags: bit 0 set if there is a start symbol (initiator);
+//                 bits 1-4 set if initiator symbol c, d, a, b is complemented
+//   44      20    zero
+//
+// Records, of 4-byte integers unless noted:
+//   grammar (16 bytes)          lhs, rhs1, rhs2, terminal character
+//                               (-1 for a rule lhs -> rhs1 rhs2)
+//   pair grammar (28 bytes)     lhs (a, d), rhs1 (a, d), rhs2 (a, d), terminal character
+//   insertion system (32 bytes) symbols a, b, c, d; a byte with bits 0-3 set if
+//                               a, b, c, d are complemented; the sign '+' or '-'
+//                               as a byte; 6 zero bytes; the rate as an 8-byte double
+// Symbols are non-terminal indices in grammars and pair grammars, and
+// symbol values (without the complement) in insertion systems.
+
+static const int BINARY_HEADER_SIZE = 64;
+static const int BINARY_VERSION = 1;
+static const unsigned long long BINARY_UNKNOWN_RECORDS = ~0ULL;
+static const int GRAMMAR_RECORD_SIZE = 16;
+static const int PAIRGRAMMAR_RECORD_SIZE = 28;
+static const int SYSTEM_RECORD_SIZE = 32;
+
+class Parser;
+
+typedef struct {
+	char kind;
+	int record_size;
+	unsigned long long records;
+	int min_symbol, max_symbol;
+	int start[4];
+	unsigned int flags;
+} BinaryHeader;
+
+// Whether the parser's input is in the binary format (of any kind).
+bool is_binary(Parser& parser);
+
+// Reads the header of binary input of kind "kind", and returns where its
+// records start, or NULL (with the parser's error set) if the header is
+// not valid or the records don't fit in the input.
+const char* read_binary_header(Parser& parser, char kind, int record_size, BinaryHeader& header);
+
+// Little-endian fields
+inline int get_i32(const char* p) {
+	const unsigned char* u = (const unsigned char*) p;
+	return (int) (u[0] | (u[1] << 8) | (u[2] << 16) | ((unsigned int) u[3] << 24));
+}
+
+inline void put_i32(char* p, int v) {
+	unsigned int u = v;
+	for (int i = 0; i < 4; ++i)
+		p[i] = (char) (u >> (8 * i));
+}
+
+unsigned long long get_u64(const char* p);
+void put_u64(char* p, unsigned long long v);
+double get_f64(const char* p);
+void put_f64(char* p, double v);
+
+// Writes binary output of one kind, a record at a time. The header goes
+// out before the first record; if the number of records or the symbol
+// range isn't known by then, finish() fills them in if the output can seek.
+class BinaryWriter {
+
+	public:
+		BinaryWriter(FILE* f, char kind, int record_size);
+
+		// Header fields, to be set before the first record is written.
+		void set_start(const int start[4], unsigned int flags);
+		void set_records(unsigned long long records);
+
+		// Writes a record of record_size bytes, whose symbols lie in
+		// min_symbol .. max_symbol.
+		void write(const char* record, int min_symbol, int max_symbol);
+		// Writes the header if there were no records, and completes it.
+		// Returns false on a write error.
+		bool finish();
+
+	private:
+		void write_header();
+
+		FILE* f;
+		BinaryHeader header;
+		bool started;
+		long header_offset; /* where the header was written, or -1 if the output can't seek */
+		unsigned long long written; /* records */
+};
+
+#endif
+
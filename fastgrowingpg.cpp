@@ -8,16 +8,18 @@ The program takes a positive integer r as a command-line argument,
 and prints a pair grammar with Theta(r) rules that deterministically
 derives a string of length 2^Theta(r) to stdout. 
 This output can be piped directly into pg2is.
+With -b the pair grammar is written in the binary format of binary.h.
 */
 
+#include "pairgrammar.h"
+#include <cstring>
 #include <iostream>
-#include <sstream>
 
-using std::cout;
 using std::cerr;
 using std::endl;
 
 int main(int argc, char* argv[]) {
+	bool bflag = (argc > 2 && strcmp(argv[2], "-b") == 0);
 	if (argc < 2) {
 		cerr << "Error: no parameter k > 0 for the size of the pair grammar provided." << endl;
 		return EXIT_FAILURE;
@@ -25,20 +27,34 @@ int main(int argc, char* argv[]) {
 
 	int k = atoi(argv[1]);
 
-	cout << "# Start symbol" << endl;
-	cout << "(1, 1)" << endl << endl;
-
-	for (unsigned int i = 1; i <= k; ++i) {
-		cout << "# Step " << i << endl;
-		cout << "(" << i << ", " << i << ") -> (" << i << ", " << i+1 << ") (" << i+1 << ", " << i << ")" << endl;
-		cout << "(" << i << ", " << i+1 << ") -> (" << i << ", " << 0 << ") (" << i+1 << ", " << i+1 << ")" << endl;
-		cout << "(" << i+1 << ", " << i << ") -> (" << i+1 << ", " << i+1 << ") (" << 0 << ", " << i << ")" << endl;
-		cout << "(" << i << ", 0) -> a" << endl;
-		cout << "(0, " << i << ") -> a" << endl << endl;	
+	// The rules go to a sink that prints them, in text or binary
+	PairGrammar::Printer text(stdout);
+	PairGrammar::BinaryPrinter binary(stdout, 5ULL * k + 1);
+	PairGrammar::Sink& sink = (bflag ? (PairGrammar::Sink&) binary : text);
+	auto add = [&sink](int a, int d, int a1, int d1, int a2, int d2) {
+		PairGrammar::Rule r = {false, {a, d}, {a1, d1}, {a2, d2}, 0};
+		sink.add_rule(r);
+	};
+	auto add_terminal = [&sink](int a, int d) {
+		PairGrammar::Rule r = {true, {a, d}, {0, 0}, {0, 0}, 'a'};
+		sink.add_rule(r);
+	};
+
+	PairGrammar::Nonterminal start = {1, 1};
+	sink.set_start(start);
+	for (int i = 1; i <= k; ++i) {
+		add(i, i, i, i+1, i+1, i);
+		add(i, i+1, i, 0, i+1, i+1);
+		add(i+1, i, i+1, i+1, 0, i);
+		add_terminal(i, 0);
+		add_terminal(0, i);
 	}
-	cout << "# Finishing rule" << endl;
-	cout << "(" << k+1 << ", " << k+1 << ") -> a" << endl;
+	add_terminal(k+1, k+1); // Finishing rule
 
+	if (bflag ? !binary.finish() : fflush(stdout) != 0) {
+		cerr << "Error: cannot write output." << endl;
+		return EXIT_FAILURE;
+	}
 	return EXIT_SUCCESS;
 }
 
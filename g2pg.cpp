@@ -13,81 +13,96 @@ The input grammar must consist of lines (delimited by '\n'),
 each with one of three forms:
 1. "# ..." (a comment) or " " (whitespace).
 2. "1 -> 2 3" (a number followed by "->" followed by two more numbers)
-3. "1 -> a" (a number followed by "->" followed by a letter) 
-The order of the lines does not matter.
+3. "1 -> a" (a number followed by "->" followed by a letter or a digit) 
+The order of the lines does not matter. A grammar in the binary format
+of binary.h is also accepted, and with -b the pair grammar is written
+in that format. With -s the insertion system of the pair grammar (as
+made by pg2is) is output instead, without keeping the pair grammar.
+Its u and x are n and n + 1 for a grammar of n symbols, which may
+differ from what pg2is picks.
 */
 
 #include "grammar.h"
+#include "output.h"
+#include "parser.h"
+#include "stats.h"
+#include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 
 using std::string;
-using std::cin;
 using std::endl;
 using std::cerr;
 
-// Removes comment lines and right arrows parts ('-', '>')
-void clean_line(string &l) {
-	for (unsigned int i = 0; i < l.size(); ++i) {
-		// Comments
-		if (l[i] == '#')
-			l.erase(i);
-		else if (l[i] == '-' || l[i] == '>')
-			l[i] = ' ';
-	}	
-}
-
-int main() {
-	Grammar g;
-
-	Grammar::Rule tempRule;
-	string line;
-	while (cin) {
-		getline(cin, line); 
-		clean_line(line);
-
-		if (sscanf(line.c_str(), "%d %d %d", &tempRule.lhs, &tempRule.rhs1, &tempRule.rhs2) == 3) {
-			tempRule.is_terminal = false;	
-			g.add_rule(tempRule); 
-			continue;
+int main(int argc, char *argv[]) {
+	bool statsflag = false; /* print phase times as JSON */
+	bool bflag = false; /* write the pair grammar in binary */
+	bool sflag = false; /* output the insertion system instead */
+	for (int i = 1; i < argc; ++i) {
+		if (string(argv[i]) == "--stats")
+			statsflag = true;
+		else if (string(argv[i]) == "-b")
+			bflag = true;
+		else if (string(argv[i]) == "-s")
+			sflag = true;
+		else {
+			cerr << "Error: illegal option '" << argv[i] << "'" << endl;
+			return EXIT_FAILURE;
 		}
+	}
 
-		// Try to read the line as a (a, d) -> s rule
-		if (sscanf(line.c_str(), "%d %c", &tempRule.lhs, &tempRule.rhsTerm) == 2) {
-			tempRule.is_terminal = true;
-			g.add_rule(tempRule); 
-			continue;
-		}	
-
-		// Try to read the line as a start symbol (a, d)
-		if (sscanf(line.c_str(), "%d", &tempRule.lhs) == 1) {
-			if (g.has_start()) {
-				cerr << "Line was parsed as " << tempRule.lhs << ", but grammar already has start symbol." << endl;
-				return EXIT_FAILURE;
-			}
-			g.set_start(tempRule.lhs);
-			continue;
-		}
+	Grammar g;
 
-		// Try to read the line as the end of the file
-		if (line.find_first_not_of("\n\t") != std::string::npos) {
-			cerr << "Line has stuff but can't be parsed:" << endl << line << endl;
-			return EXIT_FAILURE;
-		}	
+	PhaseTimer timer;
+	timer.start("parse");
+	Parser parser;
+	if (!parser.open(0) || !g.read(parser)) {
+		cerr << "Error: " << parser.error() << "." << endl;
+		return EXIT_FAILURE;
 	}
 
 	// Check that the resulting grammar is valid 
+	timer.start("validate");
 	if (!g.is_valid()) {
-		fprintf(stderr, "Grammar is not valid.\n");
+		fprintf(stderr, "Grammar is not valid: %s.\n", g.error().c_str());
 		return EXIT_FAILURE;
 	}
 	
-	// Compute and output the pair grammar
-	g.pairgrammar().print();
+	// The pair grammar is output as it is computed
+	timer.start("convert");
+	if (sflag) {
+		InsertionSystem system;
+		PairGrammar::SystemBuilder builder(system);
+		g.pairgrammar(builder);
+		if (bflag) {
+			if (!system.write_binary(stdout)) {
+				cerr << "Error: cannot write output." << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else {
+			Output out(stdout, false);
+			system.print(out);
+			out.flush();
+		}
+	}
+	else if (bflag) {
+		PairGrammar::BinaryPrinter printer(stdout);
+		g.pairgrammar(printer);
+		if (!printer.finish()) {
+			cerr << "Error: cannot write output." << endl;
+			return EXIT_FAILURE;
+		}
+	}
+	else {
+		PairGrammar::Printer printer(stdout);
+		g.pairgrammar(printer);
+		fflush(stdout);
+	}
 
+	if (statsflag)
+		timer.write_json(stderr, "g2pg", "");
 	return EXIT_SUCCESS;
 }
 
-
-
-
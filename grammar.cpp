@@ -1,15 +1,19 @@
 
 #include "grammar.h"
+#include "binary.h"
+#include "parser.h"
 #include <algorithm>
+#include <deque>
 #include <iostream>
+#include <string>
+#include <utility>
 
-using std::min;
-using std::max;
-using std::begin;
-using std::end;
+using std::deque;
 using std::vector;
 using std::cout;
 using std::endl;
+using std::make_pair;
+using std::to_string;
 
 Grammar :: Grammar() {
 	_has_start = false;
@@ -31,156 +35,311 @@ void Grammar :: set_start(int n) {
 // 2. Every non-terminal in the grammar appears on the 
 // left-hand side (lhs) of some rule.
 bool Grammar :: is_valid() {
-	if (!_has_start)
+	if (!_has_start) {
+		_error = "no start symbol";
 		return false;
+	}
 
-	bool rhs1_found, rhs2_found;
 	for (unsigned int i = 0; i < rules.size(); ++i) {
-		int rhs1 = rules[i].rhs1;
-		int rhs2 = rules[i].rhs2;
-	
-		rhs1_found = rhs2_found = false;
-		for (unsigned int j = 0; j < rules.size(); ++j) {
-			rhs1_found = rhs1_found || (rules[j].lhs == rhs1); 
-			rhs2_found = rhs2_found || (rules[j].lhs == rhs2); 
+		if (rules[i].is_terminal)
+			continue;
+		int rhs[2] = {rules[i].rhs1, rules[i].rhs2};
+		for (int k = 0; k < 2; ++k) {
+			if (first_rule(rhs[k]) == -1) {
+				_error = "non-terminal " + to_string(rhs[k]) + " is not the left-hand side of any rule";
+				return false;
+			}
 		}
-	
-		if (!rhs1_found || !rhs2_found)
-			return false;	
 	}
 
 	return true;
 }
 
+const string& Grammar :: error() {
+	return _error;
+}
+
 void Grammar :: add_rule(Rule r) {
 	rules.push_back(r);
+	// Chain the rule after the earlier rules with the same lhs
+	int i = rules.size() - 1;
+	next_rules.push_back(-1);
+	pair<unordered_map<int, pair<int, int> >::iterator, bool> chain =
+		rule_chains.insert(make_pair(r.lhs, make_pair(i, i)));
+	if (!chain.second) {
+		next_rules[chain.first->second.second] = i;
+		chain.first->second.second = i;
+	}
 }
 
-// Puts the grammar symbols into a normalized form, where they are 
-// 0, 1, ..., n-1 and 0 is the start symbol. 
-void Grammar :: normalize() {
-	// Compute min and max of the indices in all non-terminals
-	vector<int> indices;	
-	for (unsigned int i = 0; i < rules.size(); ++i) {
-		indices.push_back(rules[i].lhs);
-		if (!rules[i].is_terminal) {
-			indices.push_back(rules[i].rhs1);
-			indices.push_back(rules[i].rhs2);
+int Grammar :: first_rule(int lhs) {
+	unordered_map<int, pair<int, int> >::iterator it = rule_chains.find(lhs);
+	return (it == rule_chains.end() ? -1 : it->second.first);
+}
+
+int Grammar :: next_rule(int i) {
+	return next_rules[i];
+}
+
+const Grammar::Rule& Grammar :: rule(int i) {
+	return rules[i];
+}
+
+// Rebuilds the index after the rules' symbols change.
+void Grammar :: index_rules() {
+	vector<Rule> old_rules;
+	old_rules.swap(rules);
+	rule_chains.clear();
+	next_rules.clear();
+	for (unsigned int i = 0; i < old_rules.size(); ++i)
+		add_rule(old_rules[i]);
+}
+
+// Reads a grammar, one start symbol or rule per line.
+bool Grammar :: read(Parser& parser) {
+	if (is_binary(parser))
+		return read_binary(parser);
+
+	Rule tempRule;
+	while (!parser.end_of_input()) {
+		if (!parser.integer(tempRule.lhs))
+			return parser.unexpected("an integer");
+
+		// Try to read the line as a start symbol
+		if (parser.end_of_line()) {
+			if (has_start())
+				return parser.fail("grammar already has a start symbol");
+			set_start(tempRule.lhs);
+			parser.next_line();
+			continue;
 		}
-	}
-	int min_g_index = *min_element(begin(indices), end(indices));
-	int max_g_index = *max_element(begin(indices), end(indices));
 
-	// Shift the non-terminal indices to have minimum at 0 
-	_start += -min_g_index;
-	for (unsigned int i = 0; i < rules.size(); ++i) {
-		rules[i].lhs += -min_g_index;
-		rules[i].rhs1 += -min_g_index;
-		rules[i].rhs2 += -min_g_index;
-	}
-	max_g_index += -min_g_index;		
+		if (!parser.arrow())
+			return parser.unexpected("'->'");
 
-	// Shift the non-terminal indices to be 0 through n-1, with 0 being the start symbol
-	// First, swap start with 0
-	int old_start = _start;
-	_start = 0;
-	for (unsigned int i = 0; i < rules.size(); ++i) {
-		if (rules[i].lhs == 0)
-			rules[i].lhs = -1;
-		if (rules[i].rhs1 == 0)
-			rules[i].rhs1 = -1;
-		if (rules[i].rhs2 == 0)
-			rules[i].rhs2 = -1;
+		// Try to read the line as a 1 -> 2 3 rule, then as a 1 -> a rule,
+		// where a lone digit is a terminal too (1 -> 7)
+		parser.end_of_line(); // skips to the right-hand side
+		const char* rhs = parser.bytes();
+		if (parser.integer(tempRule.rhs1)) {
+			bool digit = (parser.bytes() - rhs == 1);
+			if (digit && parser.end_of_line()) {
+				tempRule.rhsTerm = *rhs;
+				tempRule.is_terminal = true;
+			}
+			else if (!parser.integer(tempRule.rhs2))
+				return parser.unexpected("an integer");
+			else
+				tempRule.is_terminal = false;
+		}
+		else if (parser.letter(tempRule.rhsTerm))
+			tempRule.is_terminal = true;
+		else
+			return parser.unexpected("an integer or a letter");
+
+		if (!parser.end_of_line())
+			return parser.unexpected("end of line");
+		add_rule(tempRule);
+		parser.next_line();
 	}
-	for (unsigned int i = 0; i < rules.size(); ++i) {
-		if (rules[i].lhs == old_start)
-			rules[i].lhs = 0;
-		if (rules[i].rhs1 == old_start)
-			rules[i].rhs1 = 0;
-		if (rules[i].rhs2 == old_start)
-			rules[i].rhs2 = 0;
+	return true;
+}
+
+bool Grammar :: read_binary(Parser& parser) {
+	BinaryHeader header;
+	const char* p = read_binary_header(parser, 'g', GRAMMAR_RECORD_SIZE, header);
+	if (p == NULL)
+		return false;
+	bool ranged = (header.min_symbol <= header.max_symbol);
+
+	if (header.flags & 1)
+		set_start(header.start[0]);
+	rules.reserve(header.records);
+	next_rules.reserve(header.records);
+	Rule r;
+	for (unsigned long long i = 0; i < header.records; ++i, p += GRAMMAR_RECORD_SIZE) {
+		r.lhs = get_i32(p);
+		r.rhs1 = get_i32(p + 4);
+		r.rhs2 = get_i32(p + 8);
+		int terminal = get_i32(p + 12);
+		r.is_terminal = (terminal != -1);
+		if (r.is_terminal && !Parser::is_terminal(terminal))
+			return parser.fail_at(p + 12, "terminal " + to_string(terminal) + " is not a printable character");
+		r.rhsTerm = (r.is_terminal ? terminal : 0);
+
+		int symbols[3] = {r.lhs, r.rhs1, r.rhs2};
+		for (int k = 0; k < (r.is_terminal ? 1 : 3); ++k)
+			if (ranged && (symbols[k] < header.min_symbol || symbols[k] > header.max_symbol))
+				return parser.fail_at(p + 4 * k, "symbol " + to_string(symbols[k]) + " is outside the header's symbol range");
+		add_rule(r);
 	}
+	return true;
+}
+
+// Writes the grammar in the binary format of binary.h, with the rules
+// in the order they were added.
+bool Grammar :: write_binary(FILE* f) {
+	BinaryWriter writer(f, 'g', GRAMMAR_RECORD_SIZE);
+	int start[4] = {_has_start ? _start : 0, 0, 0, 0};
+	writer.set_start(start, _has_start ? 1 : 0);
+	writer.set_records(rules.size());
 	for (unsigned int i = 0; i < rules.size(); ++i) {
-		if (rules[i].lhs == -1)
-			rules[i].lhs = old_start;
-		if (rules[i].rhs1 == -1)
-			rules[i].rhs1 = old_start;
-		if (rules[i].rhs2 == -1)
-			rules[i].rhs2 = old_start;
+		const Rule& r = rules[i];
+		char record[GRAMMAR_RECORD_SIZE] = {0};
+		put_i32(record, r.lhs);
+		if (r.is_terminal) {
+			put_i32(record + 12, (unsigned char) r.rhsTerm);
+			writer.write(record, r.lhs, r.lhs);
+		}
+		else {
+			put_i32(record + 4, r.rhs1);
+			put_i32(record + 8, r.rhs2);
+			put_i32(record + 12, -1);
+			writer.write(record, std::min(r.lhs, std::min(r.rhs1, r.rhs2)), std::max(r.lhs, std::max(r.rhs1, r.rhs2)));
+		}
 	}
-	// Second, find all distinct non-terminals and count how many there are
-	vector<bool> present;
-	for (unsigned int i = 0; i < max_g_index+1; ++i)
-		present.push_back(false);
+	return writer.finish();
+}
+
+// Puts the grammar symbols into a normalized form, where they are 
+// 0, 1, ..., n-1 and 0 is the start symbol. The other symbols are 
+// numbered in order of first appearance, in one pass over the rules.
+// Returns the number of symbols n.
+int Grammar :: normalize() {
+	unordered_map<int, int> ids;
+	ids[_start] = 0;
 	for (unsigned int i = 0; i < rules.size(); ++i) {
-		present[rules[i].lhs] = true;
-		present[rules[i].rhs1] = true;
-		present[rules[i].rhs2] = true;
-	}
-	int n = 0;
-	for (unsigned int i = 0; i < max_g_index + 1; ++i)
-		n += (present[i] ? 1 : 0);
-	// Third, change non-terminal indices until they form a solid block from 0 up to n-1
-	int low_index = 1; // we already have 0 covered by the start symbol
-	for (unsigned int i = n; i < max_g_index + 1; ++i) {
-		if (present[i]) {
-			while (present[low_index])
-				++low_index;
-			// now change all occurrances of i in grammar with low index
-			for (unsigned int j = 0; j < rules.size(); ++j) {
-				if (rules[j].lhs == i)
-					rules[j].lhs = low_index;
-				if (rules[j].rhs1 == i)
-					rules[j].rhs1 = low_index;
-				if (rules[j].rhs2 == i)
-					rules[j].rhs2 = low_index;
-			}
-			// change present array to be correct
-			present[i] = false;
-			present[low_index] = true;
+		Rule& r = rules[i];
+		r.lhs = ids.insert(make_pair(r.lhs, (int) ids.size())).first->second;
+		if (!r.is_terminal) {
+			r.rhs1 = ids.insert(make_pair(r.rhs1, (int) ids.size())).first->second;
+			r.rhs2 = ids.insert(make_pair(r.rhs2, (int) ids.size())).first->second;
 		}
 	}
+	_start = 0;
+	index_rules();
+	return ids.size();
 }
 
-PairGrammar Grammar :: pairgrammar() {
-	normalize(); // Relabel the grammar symbols to being 0, 1, ..., n-1 with 0 being start symbol
+// Set of pairs (a, d), as keys a * n + d: an open-addressing table of
+// key + 1 (0 for an empty slot), kept at most 3/4 full.
+class PairSet {
+	public:
+		PairSet() : slots(16, 0), used(0) {}
+
+		// Adds "key", returning whether it was not in the set already.
+		bool insert(unsigned long long key) {
+			unsigned long long mask = slots.size() - 1;
+			unsigned long long i = slot(key, mask);
+			for (; slots[i] != 0; i = (i + 1) & mask)
+				if (slots[i] == key + 1)
+					return false;
+			slots[i] = key + 1;
+			if (++used * 4 > slots.size() * 3)
+				grow();
+			return true;
+		}
+
+	private:
+		// Fibonacci hashing, as consecutive keys are common
+		static unsigned long long slot(unsigned long long key, unsigned long long mask) {
+			return ((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+		}
+
+		void grow() {
+			vector<unsigned long long> old(2 * slots.size(), 0);
+			old.swap(slots);
+			unsigned long long mask = slots.size() - 1;
+			for (unsigned long long j = 0; j < old.size(); ++j) {
+				if (old[j] == 0)
+					continue;
+				unsigned long long i = slot(old[j] - 1, mask);
+				while (slots[i] != 0)
+					i = (i + 1) & mask;
+				slots[i] = old[j];
+			}
+		}
+
+		vector<unsigned long long> slots;
+		unsigned long long used;
+};
+
+// Builds the pair grammar of Lemma 3.2, where pair non-terminal (a, d)
+// derives what symbol (a + d) mod n does. Each rule X -> Y Z gives the
+// rules (a, d) -> (a, b) (c, d) with a + d = X, a + b = Y and c + d = Z
+// (mod n), one for each a, but only the pairs reachable from the start
+// (0, 0) are expanded, from a worklist.
+//
+// Each rule goes to "sink" as soon as it is generated, so besides the
+// grammar only the pairs reached so far are kept. The pair indices are
+// below the n of normalize(), which the sink gets first through
+// set_indices(), so a PairGrammar::SystemBuilder can build the insertion
+// system directly.
+void Grammar :: pairgrammar(PairGrammar::Sink& sink) {
+	int n = normalize(); // Relabel the grammar symbols to being 0, 1, ..., n-1 with 0 being start symbol
+
+	// The first rule of each symbol, so the pairs look up their rules
+	// without hashing
+	vector<int> first(n);
+	for (int x = 0; x < n; ++x)
+		first[x] = first_rule(x);
 
-	PairGrammar pg;
 	PairGrammar::Nonterminal nt;
 	PairGrammar::Rule r;
 
 	nt.a = nt.d = 0;
-	pg.set_start(nt);
+	sink.set_indices(n);
+	sink.set_start(nt);
 
-	int n = rules.size();
-	for (unsigned int i = 0; i < rules.size(); ++i) {
-		if (rules[i].is_terminal) {
-			r.is_terminal = true;
-			for (unsigned int a = 0; a < n; ++a) {
-				int d = (rules[i].lhs - a + n) % n;
-				r.lhs.a = a;
-				r.lhs.d = d;
-				r.rhsTerm = rules[i].rhsTerm;
-				pg.add_rule(r);	
-			
-			}
-		} else {
-			r.is_terminal = false;
-			for (unsigned int a = 0; a < n; ++a) {
-				int d = (rules[i].lhs - a + n) % n;
-				int b = (rules[i].rhs1 - a + n) % n;
-				int c = (rules[i].rhs2 - d + n) % n;
-				r.lhs.a = a;
-				r.lhs.d = d;
+	// The pairs reached so far, as keys a * n + d, and those not expanded
+	// yet. Besides the rules, this takes 11 to 21 bytes of table per
+	// reached pair (up to 32 while the table grows), and 8 bytes per
+	// pair waiting in the worklist.
+	PairSet seen;
+	deque<PairGrammar::Nonterminal> worklist;
+	seen.insert(0);
+	worklist.push_back(nt);
+	while (!worklist.empty()) {
+		PairGrammar::Nonterminal lhs = worklist.front();
+		worklist.pop_front();
+		int a = lhs.a;
+		int d = lhs.d;
+		int x = (a + d) % n;
+		for (int j = first[x]; j != -1; j = next_rule(j)) {
+			const Rule& rule = rules[j];
+			r.lhs = lhs;
+			r.is_terminal = rule.is_terminal;
+			if (rule.is_terminal)
+				r.rhsTerm = rule.rhsTerm;
+			else {
 				r.rhs1.a = a;
-				r.rhs1.d = b;
-				r.rhs2.a = c;
+				r.rhs1.d = (rule.rhs1 - a + n) % n;
+				r.rhs2.a = (rule.rhs2 - d + n) % n;
 				r.rhs2.d = d;
-				pg.add_rule(r);
+				PairGrammar::Nonterminal rhs[2] = {r.rhs1, r.rhs2};
+				for (int i = 0; i < 2; ++i)
+					if (seen.insert((unsigned long long) rhs[i].a * n + rhs[i].d))
+						worklist.push_back(rhs[i]);
 			}
+			sink.add_rule(r);
 		}
 	}
-	
+}
+
+// Sink collecting the rules into a PairGrammar.
+class PairGrammarBuilder : public PairGrammar::Sink {
+	public:
+		PairGrammarBuilder(PairGrammar& pg) : pg(pg) {}
+		void set_start(PairGrammar::Nonterminal nt) { pg.set_start(nt); }
+		void add_rule(const PairGrammar::Rule& r) { pg.add_rule(r); }
+	private:
+		PairGrammar& pg;
+};
+
+PairGrammar Grammar :: pairgrammar() {
+	PairGrammar pg;
+	PairGrammarBuilder builder(pg);
+	pairgrammar(builder);
 	return pg;
 }
 
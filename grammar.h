@@ -3,10 +3,19 @@
 #define GRAMMAR_H
 
 #include "pairgrammar.h"
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+using std::pair;
+using std::string;
+using std::unordered_map;
 using std::vector;
 
+class Parser;
+
 class Grammar {
 
 	public:
@@ -21,16 +30,36 @@ class Grammar {
 		int start();
 		bool has_start();	
 		bool is_valid();
+		const string& error(); /* why is_valid() failed */
 		void set_start(int n);
 		void add_rule(Rule r);
-		void normalize();
+
+		// Rules with left-hand side "lhs" are rule(first_rule(lhs)), 
+		// rule(next_rule(...)), ..., up to -1, in the order they were added.
+		int first_rule(int lhs);
+		int next_rule(int i);
+		const Rule& rule(int i);
+		// Reads a grammar in text, or in the binary format of binary.h.
+		bool read(Parser& parser);
+		bool write_binary(FILE* f);
+		int normalize();
 		void print_grammar();
 		PairGrammar pairgrammar();	
+		void pairgrammar(PairGrammar::Sink& sink);
 	
 	private:
+		void index_rules();
+		bool read_binary(Parser& parser);
+
 		int _start;	
 		bool _has_start;
 		vector<Rule> rules;
+		// Index of the rules by left-hand side: rules with the same lhs
+		// are chained through next_rules, from the first to the last of
+		// rule_chains[lhs].
+		unordered_map<int, pair<int, int> > rule_chains;
+		vector<int> next_rules;
+		string _error;
 };
 
 #endif
@@ -0,0 +1,435 @@
+
+#include "insertionsystem.h"
+#include "binary.h"
+#include "output.h"
+#include "parser.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::make_pair;
+using std::pair;
+using std::stable_sort;
+using std::string;
+using std::to_string;
+
+#define PADDING 8
+
+const InsertionSystem::Symbol InsertionSystem::NO_SYMBOL;
+
+InsertionSystem :: InsertionSystem() {
+	_has_initiator = false;
+	types = 0;
+}
+
+// Returns the id of the symbol with integer value "value",
+// complemented if "complement" is set.
+InsertionSystem::Symbol InsertionSystem :: symbol(int value, bool complement) {
+	unordered_map<int, Symbol>::iterator it = symbol_ids.find(value);
+	Symbol id;
+	if (it == symbol_ids.end()) {
+		id = symbol_values.size();
+		symbol_ids[value] = id;
+		symbol_values.push_back(value);
+	}
+	else
+		id = it->second;
+	return (id << 1) | (complement ? 1 : 0);
+}
+
+int InsertionSystem :: symbol_value(Symbol s) {
+	return symbol_values[s >> 1];
+}
+
+int InsertionSystem :: symbol_count() {
+	return symbol_values.size();
+}
+
+bool InsertionSystem :: has_initiator() {
+	return _has_initiator;
+}
+
+// Sets the initiator (c, d) (a, b), where (c, d) is the left half
+// and (a, b) the right half.
+void InsertionSystem :: set_initiator(Symbol c, Symbol d, Symbol a, Symbol b) {
+	MonomerType left = {NO_SYMBOL, NO_SYMBOL, c, d, 'l', 0};
+	MonomerType right = {a, b, NO_SYMBOL, NO_SYMBOL, 'r', 0};
+	initiator[0] = left;
+	initiator[1] = right;
+	_has_initiator = true;
+}
+
+size_t InsertionSystem::TypeHash :: operator()(const MonomerType& m) const {
+	size_t h = m.p;
+	h = h * 1000003 ^ m.a;
+	h = h * 1000003 ^ m.b;
+	h = h * 1000003 ^ m.c;
+	h = h * 1000003 ^ m.d;
+	return h;
+}
+
+bool InsertionSystem::TypeEqual :: operator()(const MonomerType& m1, const MonomerType& m2) const {
+	return (m1.a == m2.a && m1.b == m2.b && m1.c == m2.c && m1.d == m2.d && m1.p == m2.p);
+}
+
+// Adds a monomer type, unless an equal type was already added. Returns
+// false, adding nothing, if that type has a different rate.
+bool InsertionSystem :: add_monomer_type(MonomerType m) {
+	pair<unordered_map<MonomerType, int, TypeHash, TypeEqual>::iterator, bool> added =
+		type_ids.insert(make_pair(m, (int) loaded_types.size()));
+	if (added.second) {
+		loaded_types.push_back(m);
+		return true;
+	}
+	return loaded_types[added.first->second].rate == m.rate;
+}
+
+// Lays out the monomer types as a structure of arrays grouped by the
+// first symbol a site must match, so that candidate() only scans the
+// types of one group.
+void InsertionSystem :: build_index() {
+	vector<MonomerType> sorted;
+	for (unsigned int i = 0; i < loaded_types.size(); ++i)
+		if (loaded_types[i].p == '+')
+			sorted.push_back(loaded_types[i]);
+	int plus_types = sorted.size();
+	for (unsigned int i = 0; i < loaded_types.size(); ++i)
+		if (loaded_types[i].p == '-')
+			sorted.push_back(loaded_types[i]);
+	stable_sort(sorted.begin(), sorted.begin() + plus_types,
+		[](const MonomerType& m1, const MonomerType& m2) { return m1.a < m2.a; });
+	stable_sort(sorted.begin() + plus_types, sorted.end(),
+		[](const MonomerType& m1, const MonomerType& m2) { return m1.b < m2.b; });
+	types = sorted.size();
+	sorted.push_back(initiator[0]);
+	sorted.push_back(initiator[1]);
+
+	a.assign(sorted.size() + PADDING, NO_SYMBOL);
+	b.assign(sorted.size() + PADDING, NO_SYMBOL);
+	c.assign(sorted.size() + PADDING, NO_SYMBOL);
+	d.assign(sorted.size() + PADDING, NO_SYMBOL);
+	key.assign(sorted.size() + PADDING, NO_SYMBOL);
+	p.assign(sorted.size() + PADDING, '\0');
+	rate.assign(sorted.size(), 0);
+	for (unsigned int i = 0; i < sorted.size(); ++i) {
+		a[i] = sorted[i].a;
+		b[i] = sorted[i].b;
+		c[i] = sorted[i].c;
+		d[i] = sorted[i].d;
+		p[i] = sorted[i].p;
+		rate[i] = sorted[i].rate;
+	}
+	for (int i = 0; i < types; ++i)
+		key[i] = (p[i] == '+' ? d[i] : c[i]);
+
+	// Group offsets, as in a compressed sparse row layout
+	int symbols = 2 * symbol_count();
+	plus_groups.assign(symbols + 1, 0);
+	minus_groups.assign(symbols + 1, 0);
+	for (int i = 0; i < types; ++i) {
+		if (p[i] == '+')
+			++plus_groups[a[i] + 1];
+		else
+			++minus_groups[b[i] + 1];
+	}
+	plus_groups[0] = 0;
+	minus_groups[0] = plus_types;
+	for (int s = 0; s < symbols; ++s) {
+		plus_groups[s+1] += plus_groups[s];
+		minus_groups[s+1] += minus_groups[s];
+	}
+}
+
+int InsertionSystem :: size() {
+	return types;
+}
+
+int InsertionSystem :: left_initiator() {
+	return types;
+}
+
+int InsertionSystem :: right_initiator() {
+	return types + 1;
+}
+
+InsertionSystem::MonomerType InsertionSystem :: type(int t) {
+	MonomerType m = {a[t], b[t], c[t], d[t], p[t], rate[t]};
+	return m;
+}
+
+// Returns a 64-bit FNV-1a hash of the numbered monomer types, so that 
+// type numbers saved from one run can be checked against another.
+unsigned long long InsertionSystem :: fingerprint() {
+	unsigned long long h = 14695981039346656037ULL;
+	for (int t = 0; t < types + 2; ++t) {
+		Symbol symbols[4] = {a[t], b[t], c[t], d[t]};
+		for (int i = 0; i < 4; ++i) {
+			long long value = (symbols[i] == NO_SYMBOL ? -1 : 2LL * symbol_value(symbols[i]) + is_complement(symbols[i]));
+			for (int k = 0; k < 8; ++k) {
+				h ^= (value >> (8 * k)) & 0xFF;
+				h *= 1099511628211ULL;
+			}
+		}
+		h ^= (unsigned char) p[t];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+unsigned int InsertionSystem :: match_mask(const Symbol* col, Symbol s) {
+#if defined(__AVX2__)
+	__m256i v = _mm256_loadu_si256((const __m256i*) col);
+	__m256i eq = _mm256_cmpeq_epi32(v, _mm256_set1_epi32(s));
+	return _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+#elif defined(__SSE2__)
+	__m128i k = _mm_set1_epi32(s);
+	__m128i eq_lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) col), k);
+	__m128i eq_hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (col + 4)), k);
+	return _mm_movemask_ps(_mm_castsi128_ps(eq_lo)) | (_mm_movemask_ps(_mm_castsi128_ps(eq_hi)) << 4);
+#else
+	unsigned int mask = 0;
+	for (int i = 0; i < 8; ++i)
+		mask |= (col[i] == s) << i;
+	return mask;
+#endif
+}
+
+// Returns the first index i in [from, to) with col[i] == s, or -1.
+int InsertionSystem :: find(const Symbol* col, int from, int to, Symbol s) {
+	for (int i = from; i < to; i += 8) {
+		unsigned int mask = match_mask(col + i, s);
+		if (mask != 0) {
+			i += __builtin_ctz(mask);
+			return i < to ? i : -1;
+		}
+	}
+	return -1;
+}
+
+// Returns the first monomer type t >= from insertable into the site
+// between monomers of types "left" and "right", or -1 if there is none.
+int InsertionSystem :: candidate(int left, int right, int from) {
+	return candidate(c[left], d[left], a[right], b[right], from);
+}
+
+// Returns the first monomer type t >= from insertable into a site whose
+// left monomer has symbols (lc, ld) and right monomer (ra, rb), or -1.
+// For definitions of these rules, see Definitions section of http://arxiv.org/abs/1401.0359
+int InsertionSystem :: candidate(Symbol lc, Symbol ld, Symbol ra, Symbol rb, int from) {
+	if (lc == complement(rb) && ld != complement(ra)) {
+		Symbol s = complement(ld);
+		return find(&key[0], std::max(from, plus_groups[s]), plus_groups[s+1], complement(ra));
+	}
+	if (ld == complement(ra) && lc != complement(rb)) {
+		Symbol s = complement(lc);
+		return find(&key[0], std::max(from, minus_groups[s]), minus_groups[s+1], complement(rb));
+	}
+	return -1;
+}
+
+
+// Reads a symbol: an integer, followed by '*' if it is a complement.
+bool InsertionSystem :: read_symbol(Parser& parser, Symbol& s) {
+	int n;
+	if (!parser.integer(n))
+		return parser.unexpected("an integer");
+	s = symbol(n, parser.character('*'));
+	return true;
+}
+
+bool InsertionSystem :: read(Parser& parser) {
+	if (is_binary(parser))
+		return read_binary(parser);
+
+	int initiator_halves = 0;
+	Symbol halves[4] = {0, 0, 0, 0}; /* (c, d) (a, b) */
+	MonomerType m;
+
+	while (!parser.end_of_input()) {
+		if (!parser.character('('))
+			return parser.unexpected("'('");
+		// A tuple, with its sign, may span lines
+		parser.set_multiline(true);
+		if (!read_symbol(parser, m.a))
+			return false;
+		if (!parser.character(','))
+			return parser.unexpected("'*' or ','");
+		if (!read_symbol(parser, m.b))
+			return false;
+
+		if (parser.character(')')) {
+			if (initiator_halves == 2)
+				return parser.fail("more than two initiator halves specified");
+			halves[2 * initiator_halves] = m.a;
+			halves[2 * initiator_halves + 1] = m.b;
+			++initiator_halves;
+			parser.set_multiline(false);
+
+			// Check that initiator has matching symbols
+			if (initiator_halves == 2) {
+				if (halves[0] != complement(halves[3]) && halves[1] != complement(halves[2]))
+					return parser.fail("initiator has no bond");
+				set_initiator(halves[0], halves[1], halves[2], halves[3]);
+			}
+			continue;
+		}
+		if (!parser.character(','))
+			return parser.unexpected("'*', ',', or ')'");
+		if (!read_symbol(parser, m.c))
+			return false;
+		if (!parser.character(','))
+			return parser.unexpected("'*' or ','");
+		if (!read_symbol(parser, m.d))
+			return false;
+		if (!parser.character(')'))
+			return parser.unexpected("'*' or ')'");
+
+		if (parser.character('+'))
+			m.p = '+';
+		else if (parser.character('-'))
+			m.p = '-';
+		else
+			return parser.unexpected("'+' or '-'");
+		parser.set_multiline(false);
+
+		// An optional rate, for kinetic sampling
+		m.rate = 1;
+		if (!parser.end_of_line() && parser.peek() != '(') {
+			// A rate that is 0 or out of range has failed already
+			if (!parser.number(m.rate))
+				return (parser.error().empty() ? parser.unexpected("a rate, '(' or end of line") : false);
+		}
+
+		if (!add_monomer_type(m))
+			return parser.fail("monomer type was given before with a different rate");
+	}
+
+	if (initiator_halves < 2)
+		return parser.fail("no initiator specified");
+	return true;
+}
+
+// Reads an insertion system in the binary format of binary.h, interning
+// the initiator's symbols first and then those of the records in order.
+bool InsertionSystem :: read_binary(Parser& parser) {
+	BinaryHeader header;
+	const char* p = read_binary_header(parser, 's', SYSTEM_RECORD_SIZE, header);
+	if (p == NULL)
+		return false;
+	bool ranged = (header.min_symbol <= header.max_symbol);
+
+	if (!(header.flags & 1))
+		return parser.fail_at(p - BINARY_HEADER_SIZE + 40, "no initiator specified");
+	Symbol halves[4]; /* (c, d) (a, b) */
+	for (int i = 0; i < 4; ++i)
+		halves[i] = symbol(header.start[i], header.flags & (2 << i));
+	if (halves[0] != complement(halves[3]) && halves[1] != complement(halves[2]))
+		return parser.fail_at(p - BINARY_HEADER_SIZE + 24, "initiator has no bond");
+	set_initiator(halves[0], halves[1], halves[2], halves[3]);
+
+	MonomerType m;
+	for (unsigned long long i = 0; i < header.records; ++i, p += SYSTEM_RECORD_SIZE) {
+		int values[4];
+		for (int k = 0; k < 4; ++k) {
+			values[k] = get_i32(p + 4 * k);
+			if (ranged && (values[k] < header.min_symbol || values[k] > header.max_symbol))
+				return parser.fail_at(p + 4 * k, "symbol " + to_string(values[k]) + " is outside the header's symbol range");
+		}
+		unsigned char stars = p[16];
+		m.a = symbol(values[0], stars & 1);
+		m.b = symbol(values[1], stars & 2);
+		m.c = symbol(values[2], stars & 4);
+		m.d = symbol(values[3], stars & 8);
+		m.p = p[17];
+		if (m.p != '+' && m.p != '-')
+			return parser.fail_at(p + 17, "sign must be '+' or '-'");
+		m.rate = get_f64(p + 24);
+		if (!(m.rate > 0) || !std::isfinite(m.rate))
+			return parser.fail_at(p + 24, "rates must be positive and finite");
+		if (!add_monomer_type(m))
+			return parser.fail_at(p, "monomer type was given before with a different rate");
+	}
+	return true;
+}
+
+// Writes the system in the binary format of binary.h: the initiator
+// and the monomer types in the order they were added.
+bool InsertionSystem :: write_binary(FILE* f) {
+	BinaryWriter writer(f, 's', SYSTEM_RECORD_SIZE);
+	Symbol halves[4] = {initiator[0].c, initiator[0].d, initiator[1].a, initiator[1].b};
+	int start[4];
+	unsigned int flags = (_has_initiator ? 1 : 0);
+	for (int i = 0; i < 4; ++i) {
+		start[i] = (_has_initiator ? symbol_value(halves[i]) : 0);
+		if (_has_initiator && is_complement(halves[i]))
+			flags |= 2 << i;
+	}
+	writer.set_start(start, flags);
+	writer.set_records(loaded_types.size());
+
+	for (unsigned int i = 0; i < loaded_types.size(); ++i) {
+		const MonomerType& m = loaded_types[i];
+		Symbol symbols[4] = {m.a, m.b, m.c, m.d};
+		char record[SYSTEM_RECORD_SIZE] = {0};
+		int lo = symbol_value(m.a), hi = lo;
+		for (int k = 0; k < 4; ++k) {
+			int value = symbol_value(symbols[k]);
+			put_i32(record + 4 * k, value);
+			if (is_complement(symbols[k]))
+				record[16] |= 1 << k;
+			lo = std::min(lo, value);
+			hi = std::max(hi, value);
+		}
+		record[17] = m.p;
+		put_f64(record + 24, m.rate);
+		writer.write(record, lo, hi);
+	}
+	return writer.finish();
+}
+
+void InsertionSystem :: print(Output& out) {
+	if (_has_initiator) {
+		out << "# Initiator\n";
+		print_monomer(out, initiator[0], false);
+		out << " ";
+		print_monomer(out, initiator[1], false);
+		out << "\n\n";
+	}
+	out << "# Monomer types\n";
+	for (unsigned int i = 0; i < loaded_types.size(); ++i) {
+		print_monomer(out, loaded_types[i], true);
+		if (loaded_types[i].rate != 1) {
+			char rate[32];
+			snprintf(rate, sizeof(rate), " %.17g", loaded_types[i].rate);
+			out << rate;
+		}
+		out << "\n";
+	}
+}
+
+void InsertionSystem :: print_symbol(Output& out, Symbol s) {
+	out << symbol_value(s) << (is_complement(s) ? "*" : "");
+}
+
+void InsertionSystem :: print_monomer(Output& out, MonomerType m, bool sign) {
+	// The left initiator half has only its right two symbols, (c, d),
+	// and the right half only its left two, (a, b)
+	Symbol symbols[4] = {m.a, m.b, m.c, m.d};
+	int first = (m.p == 'l' ? 2 : 0);
+	int last = (m.p == 'r' ? 2 : 4);
+	out << "(";
+	for (int i = first; i < last; ++i) {
+		if (i > first)
+			out << ", ";
+		print_symbol(out, symbols[i]);
+	}
+	out << ")";
+	if (sign && m.p != 'l' && m.p != 'r')
+		out << m.p;
+}
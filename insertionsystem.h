@@ -0,0 +1,104 @@
+
+#ifndef INSERTIONSYSTEM_H
+#define INSERTIONSYSTEM_H
+
+#include <cstddef>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+using std::unordered_map;
+using std::vector;
+
+class Output;
+class Parser;
+
+class InsertionSystem {
+
+	public:
+		// Symbols are interned to dense ids: symbol id k, stored as 2k for
+		// s and 2k+1 for s*, so complementing a symbol flips its low bit.
+		typedef unsigned int Symbol;
+
+		typedef struct {
+			Symbol a, b, c, d;
+			char p; /* '+', '-', or 'l'/'r' for the initiator halves */
+			double rate; /* rate of insertion, for kinetic simulation */
+		} MonomerType;
+
+		static const Symbol NO_SYMBOL = 0xFFFFFFFF;
+
+		static Symbol complement(Symbol s) { return s ^ 1; }
+		static bool is_complement(Symbol s) { return s & 1; }
+
+		InsertionSystem();
+		Symbol symbol(int value, bool complement);
+		int symbol_value(Symbol s);
+		int symbol_count();
+		bool has_initiator();
+		void set_initiator(Symbol c, Symbol d, Symbol a, Symbol b);
+		bool add_monomer_type(MonomerType m);
+		void build_index();
+
+		// Reads an insertion system in the simulator's text format: the two
+		// initiator halves "(c, d)" and "(a, b)", and monomer types 
+		// "(a, b, c, d)+" or "(a, b, c, d)-", each optionally followed by a rate.
+		// Input in the binary format of binary.h is recognized and read as well.
+		bool read(Parser& parser);
+		bool write_binary(FILE* f);
+
+		// After build_index(), monomer types are numbered 0, 1, ..., size()-1
+		// (grouped by site signature, in input order within each group),
+		// followed by the left and right initiator halves.
+		int size();
+		int left_initiator();
+		int right_initiator();
+		MonomerType type(int t);
+		unsigned long long fingerprint();
+		int candidate(int left, int right, int from);
+		int candidate(Symbol lc, Symbol ld, Symbol ra, Symbol rb, int from);
+
+		// Prints the system in the text format read by read(): the initiator,
+		// then the monomer types in the order they were added.
+		void print(Output& out);
+		void print_symbol(Output& out, Symbol s);
+		// Prints "(a, b, c, d)", followed by the sign if "sign" is set; an
+		// initiator half prints as its two symbols only.
+		void print_monomer(Output& out, MonomerType m, bool sign);
+
+	private:
+		// Returns a bit mask of which of the 8 entries col[0..7] equal s.
+		static unsigned int match_mask(const Symbol* col, Symbol s);
+		int find(const Symbol* col, int from, int to, Symbol s);
+		bool read_symbol(Parser& parser, Symbol& s);
+		bool read_binary(Parser& parser);
+
+		bool _has_initiator;
+		MonomerType initiator[2];
+		unordered_map<int, Symbol> symbol_ids;
+		vector<int> symbol_values;
+
+		struct TypeHash {
+			size_t operator()(const MonomerType& m) const;
+		};
+		struct TypeEqual {
+			bool operator()(const MonomerType& m1, const MonomerType& m2) const;
+		};
+		unordered_map<MonomerType, int, TypeHash, TypeEqual> type_ids; /* index in loaded_types */
+		vector<MonomerType> loaded_types;
+
+		// Structure-of-arrays type table: '+' types sorted by a, then '-' types
+		// sorted by b. key is the second symbol a site must match: d for '+'
+		// types and c for '-' types. Columns are padded so the matching
+		// kernel may read past the last type.
+		int types;
+		vector<Symbol> a, b, c, d, key;
+		vector<char> p;
+		vector<double> rate;
+		// plus_groups[s] .. plus_groups[s+1]-1 are the '+' types with a = s,
+		// minus_groups likewise for '-' types with b = s.
+		vector<int> plus_groups, minus_groups;
+};
+
+#endif
+
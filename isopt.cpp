@@ -0,0 +1,86 @@
+/*
+Program for optimizing an insertion system before simulating it.
+
+The program takes an insertion system from stdin (in the simulator's
+text format, or in the binary format of binary.h) and prints an
+equivalent system to stdout, without the monomer types that can never
+be inserted starting from the initiator and without duplicate types,
+and with its symbols renumbered 0, 1, 2, ... (see optimizer.h).
+The output can be used as input to simulator, which then enumerates
+the same terminal polymers in the same order, with renumbered symbols.
+
+Options:
+-k        keep the symbols' values rather than renumbering them
+-b        write the system in the binary format of binary.h
+--stats   print phase times as JSON to stderr
+*/
+
+#include "insertionsystem.h"
+#include "optimizer.h"
+#include "output.h"
+#include "parser.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char *argv[]) {
+	bool kflag = false; /* keep symbol values */
+	bool bflag = false; /* write the system in binary */
+	bool statsflag = false; /* print phase times as JSON */
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-k") == 0)
+			kflag = true;
+		else if (strcmp(argv[i], "-b") == 0)
+			bflag = true;
+		else if (strcmp(argv[i], "--stats") == 0)
+			statsflag = true;
+		else {
+			fprintf(stderr, "Error: illegal option '%s'\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	InsertionSystem system;
+
+	PhaseTimer timer;
+	timer.start("parse");
+	Parser parser;
+	if (!parser.open(0) || !system.read(parser)) {
+		fprintf(stderr, "Error: %s.\n", parser.error().c_str());
+		return EXIT_FAILURE;
+	}
+
+	timer.start("optimize");
+	system.build_index();
+	Optimizer optimizer(system);
+	InsertionSystem optimized = optimizer.optimize(!kflag);
+
+	timer.start("output");
+	if (bflag) {
+		if (!optimized.write_binary(stdout)) {
+			fprintf(stderr, "Error: cannot write output.\n");
+			return EXIT_FAILURE;
+		}
+	}
+	else {
+		Output out(stdout, false);
+		out << "# Insertion system optimized by isopt: " << optimizer.types_kept() << " of " << system.size()
+			<< " monomer types fire in the " << optimizer.sites() << " reachable sites, "
+			<< optimizer.symbols_kept() << " of " << system.symbol_count() << " symbols are used";
+		out << (kflag ? ".\n\n" : ", renumbered from 0.\n\n");
+		optimized.print(out);
+		out.flush();
+	}
+
+	if (statsflag) {
+		Output fields;
+		fields << "  \"types\": " << system.size() << ",\n"
+			<< "  \"types_kept\": " << optimizer.types_kept() << ",\n"
+			<< "  \"symbols\": " << system.symbol_count() << ",\n"
+			<< "  \"symbols_kept\": " << optimizer.symbols_kept() << ",\n"
+			<< "  \"sites\": " << optimizer.sites();
+		timer.write_json(stderr, "isopt", fields.str());
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+
+#include "optimizer.h"
+#include "sitegraph.h"
+#include <unordered_map>
+#include <vector>
+
+using std::unordered_map;
+using std::vector;
+
+Optimizer :: Optimizer(InsertionSystem& system) : system(system) {
+	_sites = _types_kept = _symbols_kept = 0;
+}
+
+InsertionSystem Optimizer :: optimize(bool renumber) {
+	typedef InsertionSystem::Symbol Symbol;
+
+	// A type fires if it is inserted into some reachable site
+	SiteGraph graph(system);
+	vector<char> fires(system.size(), 0);
+	for (int s = 0; s < graph.size(); ++s)
+		for (int i = 0; i < graph.insertions(s); ++i)
+			fires[graph.insertion(s, i).type] = 1;
+	_sites = graph.size();
+
+	InsertionSystem optimized;
+	unordered_map<int, int> values; /* old symbol value -> new */
+	auto map = [&](Symbol s) {
+		int value = system.symbol_value(s);
+		if (renumber)
+			value = values.insert(std::make_pair(value, (int) values.size())).first->second;
+		return optimized.symbol(value, InsertionSystem::is_complement(s));
+	};
+
+	InsertionSystem::MonomerType l = system.type(system.left_initiator());
+	InsertionSystem::MonomerType r = system.type(system.right_initiator());
+	Symbol c = map(l.c);
+	Symbol d = map(l.d);
+	Symbol a = map(r.a);
+	Symbol b = map(r.b);
+	optimized.set_initiator(c, d, a, b);
+
+	// In index order, which keeps the order of the types within each
+	// group that candidate() scans
+	_types_kept = 0;
+	for (int t = 0; t < system.size(); ++t) {
+		if (!fires[t])
+			continue;
+		InsertionSystem::MonomerType m = system.type(t);
+		m.a = map(m.a);
+		m.b = map(m.b);
+		m.c = map(m.c);
+		m.d = map(m.d);
+		optimized.add_monomer_type(m);
+		++_types_kept;
+	}
+	_symbols_kept = optimized.symbol_count();
+	return optimized;
+}
+
+int Optimizer :: sites() {
+	return _sites;
+}
+
+int Optimizer :: types_kept() {
+	return _types_kept;
+}
+
+int Optimizer :: symbols_kept() {
+	return _symbols_kept;
+}
+
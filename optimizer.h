@@ -0,0 +1,37 @@
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "insertionsystem.h"
+
+// Optimization pass producing an insertion system equivalent to a given
+// one, used by isopt:
+// 1. Monomer types that can't be inserted into any site reachable from
+//    the initiator (see sitegraph.h) are dropped: they never fire.
+// 2. Duplicate monomer types are merged.
+// 3. Optionally, symbols are renumbered 0, 1, ..., in order of first
+//    appearance (initiator first), dropping the symbols of dropped types.
+// The monomer types keep their relative order, so the system's terminal
+// polymers are enumerated in the same order, with the same symbols up
+// to the renumbering.
+class Optimizer {
+
+	public:
+		// "system" must be indexed (build_index()).
+		Optimizer(InsertionSystem& system);
+		InsertionSystem optimize(bool renumber);
+
+		// Sizes of the last optimize()
+		int sites(); /* reachable site signatures */
+		int types_kept();
+		int symbols_kept();
+
+	private:
+		InsertionSystem& system;
+		int _sites;
+		int _types_kept;
+		int _symbols_kept;
+};
+
+#endif
+
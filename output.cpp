@@ -0,0 +1,99 @@
+
+#include "output.h"
+
+using std::lock_guard;
+using std::unique_lock;
+
+// At most this many full buffers wait for the background writer
+// before the caller blocks.
+static const size_t MAX_QUEUED = 4;
+
+Output :: Output() {
+	file = NULL;
+	total = 0;
+	background = false;
+	writing = done = false;
+}
+
+Output :: Output(FILE* file, bool background) {
+	this->file = file;
+	this->background = background;
+	total = 0;
+	writing = done = false;
+	text.reserve(BUFFER_SIZE + 256);
+	if (background)
+		writer = thread(&Output::write_buffers, this);
+}
+
+Output :: ~Output() {
+	flush();
+	if (background) {
+		{
+			lock_guard<mutex> guard(lock);
+			done = true;
+		}
+		changed.notify_all();
+		writer.join();
+	}
+}
+
+// Writes out the buffered text, or queues it for the background writer.
+void Output :: hand_off() {
+	total += text.size();
+	if (!background) {
+		fwrite(text.data(), 1, text.size(), file);
+		text.clear();
+		return;
+	}
+
+	unique_lock<mutex> guard(lock);
+	changed.wait(guard, [this]{ return queue.size() < MAX_QUEUED; });
+	queue.push_back(string());
+	queue.back().swap(text);
+	if (!spare.empty()) {
+		text.swap(spare.back());
+		spare.pop_back();
+	}
+	else
+		text.reserve(BUFFER_SIZE + 256);
+	changed.notify_all();
+}
+
+// Writes out all text so far, waiting for the background writer to finish.
+void Output :: flush() {
+	if (file == NULL)
+		return;
+	if (!text.empty())
+		hand_off();
+	if (background) {
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [this]{ return queue.empty() && !writing; });
+	}
+	fflush(file);
+}
+
+void Output :: write_buffers() {
+	unique_lock<mutex> guard(lock);
+	while (true) {
+		changed.wait(guard, [this]{ return !queue.empty() || done; });
+		if (queue.empty())
+			return;
+
+		string buffer;
+		buffer.swap(queue.front());
+		queue.pop_front();
+		writing = true;
+		changed.notify_all();
+
+		guard.unlock();
+		fwrite(buffer.data(), 1, buffer.size(), file);
+		buffer.clear();
+		guard.lock();
+
+		spare.push_back(string());
+		spare.back().swap(buffer);
+		writing = false;
+		changed.notify_all();
+	}
+}
+
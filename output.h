@@ -0,0 +1,102 @@
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::condition_variable;
+using std::deque;
+using std::mutex;
+using std::string;
+using std::thread;
+using std::vector;
+
+// Buffered text output for polymers and insertion traces. Text collects
+// in a large buffer, with integers formatted by hand, and is written out
+// only when the buffer fills or on flush(), never per line.
+//
+// An Output without a file just collects text (for worker threads).
+// With a background writer, full buffers are handed to a thread that
+// writes them while the caller keeps going.
+class Output {
+
+	public:
+		static const size_t BUFFER_SIZE = 1 << 20;
+
+		Output();
+		Output(FILE* file, bool background);
+		~Output();
+
+		Output& operator<<(char c) {
+			text.push_back(c);
+			return *this;
+		}
+
+		Output& operator<<(const char* s) {
+			text.append(s);
+			return check();
+		}
+
+		Output& operator<<(const string& s) {
+			text.append(s);
+			return check();
+		}
+
+		Output& operator<<(int n) {
+			if (n < 0) {
+				text.push_back('-');
+				return *this << (unsigned long long) -(long long) n;
+			}
+			return *this << (unsigned long long) n;
+		}
+
+		Output& operator<<(unsigned long long n) {
+			char digits[20];
+			int i = 20;
+			do {
+				digits[--i] = '0' + n % 10;
+				n /= 10;
+			} while (n != 0);
+			text.append(digits + i, 20 - i);
+			return check();
+		}
+
+		size_t size() { return text.size(); }
+		unsigned long long written() { return total + text.size(); } /* bytes output so far */
+		const string& str() { return text; }
+		void clear() { text.clear(); }
+		void flush();
+
+	private:
+		Output& check() {
+			if (file != NULL && text.size() >= BUFFER_SIZE)
+				hand_off();
+			return *this;
+		}
+
+		void hand_off();
+		void write_buffers();
+
+		string text;
+		FILE* file;
+		unsigned long long total; /* bytes handed off */
+
+		// Background writer: full buffers wait in "queue", and written
+		// buffers are kept in "spare" for reuse.
+		bool background;
+		thread writer;
+		mutex lock;
+		condition_variable changed;
+		deque<string> queue;
+		vector<string> spare;
+		bool writing, done;
+};
+
+#endif
+
@@ -1,5 +1,14 @@
 
 #include "pairgrammar.h"
+#include "parser.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+using std::make_pair;
+using std::max_element;
+using std::to_string;
 
 PairGrammar :: PairGrammar() {
 	_has_start = false;
@@ -16,8 +25,34 @@ void PairGrammar :: set_start(Nonterminal nt) {
 	_has_start = true;
 }
 
+size_t PairGrammar::NonterminalHash :: operator()(const Nonterminal& nt) const {
+	return (size_t) nt.a * 1000003 ^ nt.d;
+}
+
+bool PairGrammar::NonterminalEqual :: operator()(const Nonterminal& nt1, const Nonterminal& nt2) const {
+	return (nt1.a == nt2.a && nt1.d == nt2.d);
+}
+
 void PairGrammar :: add_rule(Rule r) {
 	rules.push_back(r);
+	// Chain the rule in front of the earlier rules with the same lhs
+	unordered_map<Nonterminal, int, NonterminalHash, NonterminalEqual>::iterator it = 
+		first_rules.insert(make_pair(r.lhs, -1)).first;
+	next_rules.push_back(it->second);
+	it->second = rules.size() - 1;
+}
+
+int PairGrammar :: first_rule(Nonterminal lhs) {
+	unordered_map<Nonterminal, int, NonterminalHash, NonterminalEqual>::iterator it = first_rules.find(lhs);
+	return (it == first_rules.end() ? -1 : it->second);
+}
+
+int PairGrammar :: next_rule(int i) {
+	return next_rules[i];
+}
+
+const PairGrammar::Rule& PairGrammar :: rule(int i) {
+	return rules[i];
 }
 
 bool PairGrammar :: is_valid(Rule r) {
@@ -31,51 +66,106 @@ bool PairGrammar :: is_valid(Rule r) {
 // 2. Every non-terminal in the grammar appears on the 
 // left-hand side (lhs) of some rule.
 bool PairGrammar :: is_valid() {
-	if (!_has_start)
+	char message[128];
+	if (!_has_start) {
+		_error = "no start symbol";
 		return false;
+	}
 
 	for (unsigned int i = 0; i < rules.size(); ++i) {
 		Rule r = rules[i];
 		// Check that rule is ok
-		if (!is_valid(r)) 
+		if (!is_valid(r)) {
+			sprintf(message, "(%d, %d) -> (%d, %d) (%d, %d) is an invalid rule",
+				r.lhs.a, r.lhs.d, r.rhs1.a, r.rhs1.d, r.rhs2.a, r.rhs2.d);
+			_error = message;
 			return false;
+		}
 
 		// Check that each rhs symbol appears on lhs of some rule 
 		if (r.is_terminal)
 			continue;
-
-		bool rhs1_found = false;
-		bool rhs2_found = false;
-		for (unsigned int j = 0; j < rules.size(); ++j) {
-			rhs1_found = rhs1_found || (rules[j].lhs.a == r.rhs1.a && rules[j].lhs.d == r.rhs1.d); 
-			rhs2_found = rhs2_found || (rules[j].lhs.a == r.rhs2.a && rules[j].lhs.d == r.rhs2.d); 
+		Nonterminal rhs[2] = {r.rhs1, r.rhs2};
+		for (int k = 0; k < 2; ++k) {
+			if (first_rule(rhs[k]) == -1) {
+				sprintf(message, "non-terminal (%d, %d) is not the left-hand side of any rule", rhs[k].a, rhs[k].d);
+				_error = message;
+				return false;
+			}
 		}
-	
-		if (!rhs1_found || !rhs2_found)
-			return false;	
 	}
 
 	return true;
 }
 
+const string& PairGrammar :: error() {
+	return _error;
+}
+
 void PairGrammar :: print() {
-	printf("# Start symbol\n");
-	printf("(%d, %d)\n", _start.a, _start.d);
+	Printer printer(stdout);
+	printer.set_start(_start);
+	for (unsigned int i = 0; i < rules.size(); ++i)
+		printer.add_rule(rules[i]);
+}
 
-	printf("# Rules\n");
-	for (unsigned int i = 0; i < rules.size(); ++i) {
-		Rule r = rules[i];
-		if (r.is_terminal)	
-			printf("(%d, %d) -> %c\n", r.lhs.a, r.lhs.d, r.rhsTerm);
-		else
-			printf("(%d, %d) -> (%d, %d) (%d, %d)\n", r.lhs.a, r.lhs.d, r.rhs1.a, r.rhs1.d, r.rhs2.a, r.rhs2.d);
-	}	
+PairGrammar::Printer :: Printer(FILE* f) {
+	this->f = f;
 }
 
-void PairGrammar :: print_insertion_system() {
-	// Compute range of non-terminal indices to enable finding values 
-	// for u, x, and range for terminal characters that doesn't interfere
-	// Compute min and max of the indices in all non-terminals
+void PairGrammar::Printer :: set_start(Nonterminal nt) {
+	fprintf(f, "# Start symbol\n");
+	fprintf(f, "(%d, %d)\n", nt.a, nt.d);
+
+	fprintf(f, "# Rules\n");
+}
+
+void PairGrammar::Printer :: add_rule(const Rule& r) {
+	if (r.is_terminal)	
+		fprintf(f, "(%d, %d) -> %c\n", r.lhs.a, r.lhs.d, r.rhsTerm);
+	else
+		fprintf(f, "(%d, %d) -> (%d, %d) (%d, %d)\n", r.lhs.a, r.lhs.d, r.rhs1.a, r.rhs1.d, r.rhs2.a, r.rhs2.d);
+}
+
+PairGrammar::BinaryPrinter :: BinaryPrinter(FILE* f, unsigned long long rules) 
+	: writer(f, 'p', PAIRGRAMMAR_RECORD_SIZE) {
+	writer.set_records(rules);
+}
+
+void PairGrammar::BinaryPrinter :: set_start(Nonterminal nt) {
+	int start[4] = {nt.a, nt.d, 0, 0};
+	writer.set_start(start, 1);
+}
+
+void PairGrammar::BinaryPrinter :: add_rule(const Rule& r) {
+	char record[PAIRGRAMMAR_RECORD_SIZE] = {0};
+	int indices[6] = {r.lhs.a, r.lhs.d, r.rhs1.a, r.rhs1.d, r.rhs2.a, r.rhs2.d};
+	int used = (r.is_terminal ? 2 : 6);
+	int lo = indices[0], hi = indices[0];
+	for (int i = 0; i < used; ++i) {
+		put_i32(record + 4 * i, indices[i]);
+		lo = std::min(lo, indices[i]);
+		hi = std::max(hi, indices[i]);
+	}
+	put_i32(record + 24, r.is_terminal ? (unsigned char) r.rhsTerm : -1);
+	writer.write(record, lo, hi);
+}
+
+bool PairGrammar::BinaryPrinter :: finish() {
+	return writer.finish();
+}
+
+bool PairGrammar :: write_binary(FILE* f) {
+	BinaryPrinter printer(f, rules.size());
+	if (_has_start)
+		printer.set_start(_start);
+	for (unsigned int i = 0; i < rules.size(); ++i)
+		printer.add_rule(rules[i]);
+	return printer.finish();
+}
+
+// Returns the largest index in any non-terminal.
+int PairGrammar :: max_index() {
 	vector<int> indices;
 	for (unsigned int i = 0; i < rules.size(); ++i) {
 		indices.push_back(rules[i].lhs.a);
@@ -87,7 +177,13 @@ void PairGrammar :: print_insertion_system() {
 			indices.push_back(rules[i].rhs2.d);
 		}
 	}
-	int max_pg_index = *max_element(begin(indices), end(indices));	
+	return *max_element(begin(indices), end(indices));	
+}
+
+void PairGrammar :: print_insertion_system() {
+	// Compute range of non-terminal indices to enable finding values 
+	// for u, x, and range for terminal characters that doesn't interfere
+	int max_pg_index = max_index();
 	int u_index = max_pg_index + 1;
 	int x_index = u_index + 1;
 	int terminal_shift = x_index + 1;
@@ -127,4 +223,163 @@ void PairGrammar :: print_insertion_system() {
 
 }
 
+PairGrammar::SystemBuilder :: SystemBuilder(InsertionSystem& system) : system(system) {
+	set_indices(0);
+}
+
+void PairGrammar::SystemBuilder :: set_indices(int n) {
+	u_index = n;
+	x_index = u_index + 1;
+	terminal_shift = x_index + 1;
+}
+
+void PairGrammar::SystemBuilder :: set_start(Nonterminal nt) {
+	InsertionSystem::Symbol c = system.symbol(u_index, false);
+	InsertionSystem::Symbol d = system.symbol(nt.a, false);
+	InsertionSystem::Symbol a = system.symbol(nt.d, false);
+	InsertionSystem::Symbol b = system.symbol(u_index, true);
+	system.set_initiator(c, d, a, b);
+}
+
+// Adds the monomers of the rule, following the proof of Lemma 3.3 as in
+// print_insertion_system().
+void PairGrammar::SystemBuilder :: add_rule(const Rule& r) {
+	if (!r.is_terminal) {
+		add(r.rhs1.d, u_index, r.rhs1.d, x_index, " ** ", '-'); // Delta_1'
+		add(r.rhs1.a, r.rhs1.d, r.rhs2.a, r.rhs2.d, "* **", '+'); // Delta_2'
+		add(x_index, r.rhs2.a, u_index, r.rhs2.a, "    ", '-'); // Delta_3'
+	} else
+		add(r.lhs.a, r.rhsTerm + terminal_shift, x_index, r.lhs.d, "*  *", '+'); // Delta_4'
+}
+
+// Adds monomer (a, b, c, d)p, with the symbols marked '*' in "stars" complemented.
+void PairGrammar::SystemBuilder :: add(int a, int b, int c, int d, const char* stars, char p) {
+	InsertionSystem::MonomerType m;
+	m.a = system.symbol(a, stars[0] == '*');
+	m.b = system.symbol(b, stars[1] == '*');
+	m.c = system.symbol(c, stars[2] == '*');
+	m.d = system.symbol(d, stars[3] == '*');
+	m.p = p;
+	m.rate = 1;
+	system.add_monomer_type(m);
+}
+
+// Builds the insertion system printed by print_insertion_system() in
+// memory, with the same symbols, interned in the same order as reading
+// the printed system would.
+InsertionSystem PairGrammar :: insertion_system() {
+	InsertionSystem system;
+	SystemBuilder builder(system);
+	builder.set_indices(max_index() + 1);
+	builder.set_start(_start);
+	for (unsigned int i = 0; i < rules.size(); ++i)
+		builder.add_rule(rules[i]);
+	return system;
+}
+
+// Reads a nonterminal "(a, d)".
+bool PairGrammar :: read_nonterminal(Parser& parser, Nonterminal& nt) {
+	if (!parser.character('('))
+		return parser.unexpected("'('");
+	if (!parser.integer(nt.a))
+		return parser.unexpected("an integer");
+	if (!parser.character(','))
+		return parser.unexpected("','");
+	if (!parser.integer(nt.d))
+		return parser.unexpected("an integer");
+	if (!parser.character(')'))
+		return parser.unexpected("')'");
+	return true;
+}
+
+// Reads a pair grammar, one start symbol or rule per line.
+bool PairGrammar :: read(Parser& parser) {
+	if (is_binary(parser))
+		return read_binary(parser);
+
+	Rule r;
+	char message[128];
+	while (!parser.end_of_input()) {
+		if (!read_nonterminal(parser, r.lhs))
+			return false;
 
+		// Try to read the line as a start symbol (a, d)
+		if (parser.end_of_line()) {
+			if (has_start()) {
+				sprintf(message, "(%d, %d) was parsed as a start symbol, but pair grammar already has a start symbol", 
+					r.lhs.a, r.lhs.d);
+				return parser.fail(message);
+			}
+			set_start(r.lhs);
+			parser.next_line();
+			continue;
+		}
+
+		if (!parser.arrow())
+			return parser.unexpected("'->'");
+
+		// Try to read the line as a (a, d) -> s rule, then as a (a, d) -> (a, b) (c, d) rule
+		if (parser.terminal(r.rhsTerm)) {
+			r.is_terminal = true;
+			sprintf(message, "(%d, %d) -> %c is an invalid rule", r.lhs.a, r.lhs.d, r.rhsTerm);
+		}
+		else {
+			if (!read_nonterminal(parser, r.rhs1) || !read_nonterminal(parser, r.rhs2))
+				return false;
+			r.is_terminal = false;
+			sprintf(message, "(%d, %d) -> (%d, %d) (%d, %d) is an invalid rule",
+				r.lhs.a, r.lhs.d, r.rhs1.a, r.rhs1.d, r.rhs2.a, r.rhs2.d);
+		}
+
+		if (!parser.end_of_line())
+			return parser.unexpected("end of line");
+		if (!is_valid(r))
+			return parser.fail(message);
+		add_rule(r);
+		parser.next_line();
+	}
+	return true;
+}
+
+bool PairGrammar :: read_binary(Parser& parser) {
+	BinaryHeader header;
+	const char* p = read_binary_header(parser, 'p', PAIRGRAMMAR_RECORD_SIZE, header);
+	if (p == NULL)
+		return false;
+	bool ranged = (header.min_symbol <= header.max_symbol);
+
+	if (header.flags & 1) {
+		Nonterminal start = {header.start[0], header.start[1]};
+		set_start(start);
+	}
+	rules.reserve(header.records);
+	next_rules.reserve(header.records);
+	Rule r;
+	for (unsigned long long i = 0; i < header.records; ++i, p += PAIRGRAMMAR_RECORD_SIZE) {
+		int terminal = get_i32(p + 24);
+		r.is_terminal = (terminal != -1);
+		if (r.is_terminal && !Parser::is_terminal(terminal))
+			return parser.fail_at(p + 24, "terminal " + to_string(terminal) + " is not a printable character");
+		r.rhsTerm = (r.is_terminal ? terminal : 0);
+
+		int indices[6];
+		for (int k = 0; k < 6; ++k) {
+			indices[k] = get_i32(p + 4 * k);
+			if (ranged && (k < 2 || !r.is_terminal) 
+				&& (indices[k] < header.min_symbol || indices[k] > header.max_symbol))
+				return parser.fail_at(p + 4 * k, "index " + to_string(indices[k]) + " is outside the header's symbol range");
+		}
+		r.lhs.a = indices[0];
+		r.lhs.d = indices[1];
+		r.rhs1.a = indices[2];
+		r.rhs1.d = indices[3];
+		r.rhs2.a = indices[4];
+		r.rhs2.d = indices[5];
+		if (!is_valid(r))
+			return parser.fail_at(p, "(" + to_string(r.lhs.a) + ", " + to_string(r.lhs.d) + ") -> (" 
+				+ to_string(r.rhs1.a) + ", " + to_string(r.rhs1.d) + ") (" 
+				+ to_string(r.rhs2.a) + ", " + to_string(r.rhs2.d) + ") is an invalid rule");
+		add_rule(r);
+	}
+	return true;
+}
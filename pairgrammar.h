@@ -2,10 +2,19 @@
 #ifndef PAIRGRAMMAR_H
 #define PAIRGRAMMAR_H
 
+#include "binary.h"
+#include "insertionsystem.h"
+#include <cstdio>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+using std::string;
+using std::unordered_map;
 using std::vector;
 
+class Parser;
+
 class PairGrammar {
 
 	public:
@@ -20,21 +29,98 @@ class PairGrammar {
 			char rhsTerm;
 		} Rule;
 
+		// Receives the start symbol and then the rules of a pair grammar
+		// as they are generated (see Grammar::pairgrammar()), so that they
+		// need not all be kept in memory. set_indices(n), if called, comes
+		// first and says that all the indices are below n.
+		class Sink {
+			public:
+				virtual ~Sink() {}
+				virtual void set_indices(int n) {}
+				virtual void set_start(Nonterminal nt) = 0;
+				virtual void add_rule(const Rule& r) = 0;
+		};
+
+		// Sink printing the grammar in the text format read by read().
+		class Printer : public Sink {
+			public:
+				Printer(FILE* f);
+				void set_start(Nonterminal nt);
+				void add_rule(const Rule& r);
+			private:
+				FILE* f;
+		};
+
+		// Sink writing the grammar in the binary format of binary.h, of
+		// "rules" rules if known in advance. finish() completes the output.
+		class BinaryPrinter : public Sink {
+			public:
+				BinaryPrinter(FILE* f, unsigned long long rules = BINARY_UNKNOWN_RECORDS);
+				void set_start(Nonterminal nt);
+				void add_rule(const Rule& r);
+				bool finish();
+			private:
+				BinaryWriter writer;
+		};
+
+		// Sink building the insertion system of print_insertion_system()
+		// in "system". Needs set_indices(n): u = n, x = u + 1, and
+		// terminals are shifted by x + 1.
+		class SystemBuilder : public Sink {
+			public:
+				SystemBuilder(InsertionSystem& system);
+				void set_indices(int n);
+				void set_start(Nonterminal nt);
+				void add_rule(const Rule& r);
+			private:
+				void add(int a, int b, int c, int d, const char* stars, char p);
+
+				InsertionSystem& system;
+				int u_index, x_index, terminal_shift;
+		};
+
 		PairGrammar();
 		int start();
 		bool has_start();
 		bool is_valid();
+		const string& error(); /* why is_valid() failed */
 		void set_start(Nonterminal nt);
 		void add_rule(Rule r);
+
+		// Rules with left-hand side "lhs" are rule(first_rule(lhs)), 
+		// rule(next_rule(...)), ..., up to -1.
+		int first_rule(Nonterminal lhs);
+		int next_rule(int i);
+		const Rule& rule(int i);
+		// Reads a pair grammar in text, or in the binary format of binary.h.
+		bool read(Parser& parser);
+		bool write_binary(FILE* f);
 		void print();
 		void print_insertion_system();
+		InsertionSystem insertion_system();
 		
 		static bool is_valid(Rule r);
 
 	private:
+		struct NonterminalHash {
+			size_t operator()(const Nonterminal& nt) const;
+		};
+		struct NonterminalEqual {
+			bool operator()(const Nonterminal& nt1, const Nonterminal& nt2) const;
+		};
+
+		bool read_nonterminal(Parser& parser, Nonterminal& nt);
+		bool read_binary(Parser& parser);
+		int max_index();
+
 		Nonterminal _start;
 		bool _has_start;
 		vector<Rule> rules;
+		// Index of the rules by left-hand side: rules with the same lhs
+		// are chained through next_rules, starting at first_rules[lhs].
+		unordered_map<Nonterminal, int, NonterminalHash, NonterminalEqual> first_rules;
+		vector<int> next_rules;
+		string _error;
 };
 
 #endif
@@ -0,0 +1,249 @@
+
+#include "parser.h"
+#include <climits>
+#include <cmath>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Inputs that can't be mapped are read this much at a time.
+static const size_t BLOCK_SIZE = 1 << 20;
+
+Parser :: Parser() {
+	text = cur = end = line_start = NULL;
+	line = 1;
+	multiline = false;
+	mapped = 0;
+}
+
+Parser :: ~Parser() {
+	if (mapped != 0)
+		munmap((void*) text, mapped);
+}
+
+// Loads the input from file descriptor fd, returning false on a read error.
+bool Parser :: open(int fd) {
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			mapped = st.st_size;
+			text = (const char*) p;
+			madvise(p, mapped, MADV_SEQUENTIAL);
+		}
+	}
+
+	if (mapped == 0) {
+		size_t size = 0;
+		while (true) {
+			buffer.resize(size + BLOCK_SIZE);
+			ssize_t n = read(fd, &buffer[size], BLOCK_SIZE);
+			if (n < 0)
+				return fail("cannot read input");
+			if (n == 0)
+				break;
+			size += n;
+		}
+		buffer.resize(size);
+		text = buffer.data();
+		mapped = 0;
+	}
+
+	cur = line_start = text;
+	end = text + (mapped != 0 ? mapped : buffer.size());
+	line = 1;
+	return true;
+}
+
+void Parser :: skip_spaces() {
+	while (cur != end) {
+		if (*cur == ' ' || *cur == '\t' || *cur == '\r')
+			++cur;
+		else if (*cur == '#') {
+			while (cur != end && *cur != '\n')
+				++cur;
+		}
+		else if (*cur == '\n' && multiline)
+			next_line();
+		else
+			break;
+	}
+}
+
+void Parser :: set_multiline(bool multiline) {
+	this->multiline = multiline;
+}
+
+bool Parser :: end_of_line() {
+	skip_spaces();
+	return cur == end || *cur == '\n';
+}
+
+void Parser :: next_line() {
+	while (cur != end && *cur != '\n')
+		++cur;
+	if (cur != end) {
+		++cur;
+		++line;
+		line_start = cur;
+	}
+}
+
+bool Parser :: end_of_input() {
+	while (end_of_line() && cur != end)
+		next_line();
+	return cur == end;
+}
+
+bool Parser :: integer(int& n) {
+	skip_spaces();
+	const char* p = cur;
+	bool negative = (p != end && *p == '-');
+	if (negative)
+		++p;
+	if (p == end || *p < '0' || *p > '9')
+		return false;
+
+	long long value = 0;
+	while (p != end && *p >= '0' && *p <= '9') {
+		value = value * 10 + (*p - '0');
+		if (value > INT_MAX) 
+			return fail("integer out of range");
+		++p;
+	}
+	n = (int) (negative ? -value : value);
+	cur = p;
+	return true;
+}
+
+bool Parser :: number(double& x) {
+	skip_spaces();
+	const char* p = cur;
+	double value = 0;
+	bool digits = false;
+	while (p != end && *p >= '0' && *p <= '9') {
+		value = value * 10 + (*p++ - '0');
+		digits = true;
+	}
+	if (p != end && *p == '.') {
+		double scale = 0.1;
+		for (++p; p != end && *p >= '0' && *p <= '9'; ++p, scale /= 10) {
+			value += (*p - '0') * scale;
+			digits = true;
+		}
+	}
+	if (!digits)
+		return false;
+
+	if (p != end && (*p == 'e' || *p == 'E')) {
+		const char* q = p + 1;
+		bool negative = (q != end && *q == '-');
+		if (q != end && (*q == '-' || *q == '+'))
+			++q;
+		int exponent = 0;
+		if (q != end && *q >= '0' && *q <= '9') {
+			for (; q != end && *q >= '0' && *q <= '9'; ++q)
+				if (exponent < 10000)
+					exponent = exponent * 10 + (*q - '0');
+			for (int i = 0; i < exponent; ++i)
+				value = (negative ? value / 10 : value * 10);
+			p = q;
+		}
+	}
+
+	// Fail at the token, as overflowing to inf or underflowing to 0
+	// would otherwise pass for a number
+	if (!std::isfinite(value))
+		return fail("number out of range");
+	if (value <= 0)
+		return fail("number must be positive");
+	x = value;
+	cur = p;
+	return true;
+}
+
+bool Parser :: character(char c) {
+	skip_spaces();
+	if (cur == end || *cur != c)
+		return false;
+	++cur;
+	return true;
+}
+
+bool Parser :: arrow() {
+	skip_spaces();
+	if (end - cur < 2 || cur[0] != '-' || cur[1] != '>')
+		return false;
+	cur += 2;
+	return true;
+}
+
+bool Parser :: letter(char& c) {
+	skip_spaces();
+	if (cur == end || !is_letter(*cur))
+		return false;
+	c = *cur++;
+	return true;
+}
+
+bool Parser :: is_letter(int c) {
+	return c > ' ' && c <= '~' && !(c >= '0' && c <= '9') && c != '(' && c != ')' && c != ',' && c != '#';
+}
+
+bool Parser :: terminal(char& c) {
+	skip_spaces();
+	if (cur == end || !is_terminal(*cur))
+		return false;
+	c = *cur++;
+	return true;
+}
+
+bool Parser :: is_terminal(int c) {
+	return is_letter(c) || (c >= '0' && c <= '9');
+}
+
+char Parser :: peek() {
+	return (cur == end ? '\0' : *cur);
+}
+
+const char* Parser :: bytes() {
+	return cur;
+}
+
+size_t Parser :: bytes_left() {
+	return end - cur;
+}
+
+bool Parser :: fail(const string& message) {
+	// Keep the first error, which is where parsing stopped
+	if (!_error.empty())
+		return false;
+	std::ostringstream s;
+	s << "line " << line << ", column " << (cur - line_start) + 1 << ": " << message;
+	_error = s.str();
+	return false;
+}
+
+bool Parser :: fail_at(const char* at, const string& message) {
+	if (!_error.empty())
+		return false;
+	std::ostringstream s;
+	s << "byte " << (at - text) << ": " << message;
+	_error = s.str();
+	return false;
+}
+
+bool Parser :: unexpected(const string& expected) {
+	skip_spaces();
+	if (cur == end)
+		return fail("unexpected end of input, expected " + expected);
+	if (*cur == '\n')
+		return fail("unexpected end of line, expected " + expected);
+	return fail(string("unexpected token '") + *cur + "', expected " + expected);
+}
+
+const string& Parser :: error() {
+	return _error;
+}
+
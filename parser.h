@@ -0,0 +1,84 @@
+
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Tokenizer shared by the grammar, pair grammar and insertion system 
+// readers. The whole input is memory-mapped if it is a regular file, and
+// otherwise read in large blocks, then scanned once. Errors are reported
+// with the line and column where they occur.
+//
+// In all three formats '#' starts a comment running to the end of the line.
+class Parser {
+
+	public:
+		Parser();
+		~Parser();
+		bool open(int fd);
+
+		// Skips spaces, tabs and comments but not newlines, and returns 
+		// whether the line has ended.
+		bool end_of_line();
+		// Skips to the start of the next line.
+		void next_line();
+		// Skips whitespace (including newlines) and comments, and returns 
+		// whether the input has ended.
+		bool end_of_input();
+
+		// Whether the tokens below may also be separated by newlines, as
+		// inside an insertion system's tuples (default: false).
+		void set_multiline(bool multiline);
+
+		// Each of these first skips spaces, tabs and comments (and newlines
+		// if multiline), and then returns whether the next token is the one
+		// asked for, consuming it if so.
+		bool integer(int& n);
+		// A positive, finite decimal number, such as 2, 0.5 or 1.5e3;
+		// fails with error() set at the token if it is 0 or out of range.
+		bool number(double& x);
+		bool character(char c);
+		bool arrow(); /* "->" */
+		bool letter(char& c); /* anything printable but a digit, '(', ')', ',' or '#' */
+		static bool is_letter(int c);
+		// A pair grammar's terminal, which can't be mistaken for a number
+		// where it appears: a letter or a digit.
+		bool terminal(char& c);
+		static bool is_terminal(int c);
+
+		// The next character, or '\0' at the end of the input.
+		char peek();
+
+		// The rest of the input as raw bytes, for the binary formats (see binary.h).
+		const char* bytes();
+		size_t bytes_left();
+
+		// Sets error() to "line L, column C: <message>" at the current position.
+		bool fail(const string& message);
+		// As fail(), for a message of the form "unexpected token 'x', expected <expected>".
+		bool unexpected(const string& expected);
+		// Sets error() to "byte B: <message>", for binary input, where B is
+		// the offset of "at" in the input.
+		bool fail_at(const char* at, const string& message);
+		const string& error();
+
+	private:
+		void skip_spaces();
+
+		const char* text;
+		const char* cur;
+		const char* end;
+		const char* line_start;
+		int line;
+		bool multiline;
+		size_t mapped; /* length of the mapping, or 0 if text was read */
+		vector<char> buffer;
+		string _error;
+};
+
+#endif
+
@@ -18,91 +18,67 @@ each with one of three forms:
 				the first 2-tuple.)
 3. "(1, 2) -> a"	(an integer 2-tuple number followed by "->" 
 			followed by a letter.) 
-The order of the lines does not matter.
+The order of the lines does not matter. A pair grammar in the binary
+format of binary.h is also accepted, and with -b the insertion system
+is written in that format.
 */
 
 #include "pairgrammar.h"
+#include "parser.h"
+#include "stats.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #define MIN(X,Y) ((X) < (Y) ? (X) : (Y))
 #define MAX(X,Y) ((X) > (Y) ? (X) : (Y))
 
-void clean(char buf[]) {
-	int i;
-	for(i = 0; i < BUFSIZ && buf[i] != '\0'; i++) {
-		// Comments
-		if(buf[i] == '#') 
-			buf[i] = '\0';
-		// Right arrows
-		else if(buf[i] == '-' || buf[i] == '>')
-			buf[i] = ' ';
-		// Tuple cruft 
-		else if (buf[i] == ',' || buf[i] == '(' || buf[i] == ')')
-			buf[i] = ' ';
-	}	
-}
-
-int main() {
-	PairGrammar pg;
-
-	char buf[BUFSIZ];
-	PairGrammar::Rule r;
-	while (fgets(buf, sizeof buf, stdin)) {
-		clean(buf);		
-
-		// Try to read the line as a (a, d) -> (a, b) (c, d) rule
-		if (sscanf(buf,"%d %d %d %d %d %d", &r.lhs.a, &r.lhs.d, &r.rhs1.a, &r.rhs1.d, &r.rhs2.a, &r.rhs2.d) == 6) {
-			r.is_terminal = false;	
-			if (!PairGrammar::is_valid(r)) {
-				fprintf(stderr, "Line was parsed as (%d, %d) -> (%d, %d) (%d, %d), an invalid rule:\n	%s\n",
-					r.lhs.a, r.lhs.d, r.rhs1.a, r.rhs1.d, r.rhs2.a, r.rhs2.d, buf); 
-				return EXIT_FAILURE;
-			}
-			pg.add_rule(r);
-			continue;
-		}
-
-		// Try to read the line as a (a, d) -> s rule
-		if (sscanf(buf,"%d %d %c", &r.lhs.a, &r.lhs.d, &r.rhsTerm) == 3) {
-			r.is_terminal = true;
-			if (!PairGrammar::is_valid(r)) {
-				fprintf(stderr, "Line was parsed as (%d, %d) -> %c, an invalid rule:\n	%s\n",
-					r.lhs.a, r.lhs.d, r.rhsTerm, buf);
-				return EXIT_FAILURE;
-			}
-			pg.add_rule(r);
-			continue;
-		}	
-
-		// Try to read the line as a start symbol (a, d)
-		if (sscanf(buf, "%d %d", &r.lhs.a, &r.lhs.d) == 2) {
-			if (pg.has_start()) {
-				fprintf(stderr, "Line was parsed as (%d, %d), but pair grammar already has a start symbol:\n	%s\n",
-					r.lhs.a, r.lhs.d, buf);
-				return EXIT_FAILURE;
-			}
-			pg.set_start(r.lhs);
-			continue;
+int main(int argc, char *argv[]) {
+	bool statsflag = false; /* print phase times as JSON */
+	bool bflag = false; /* write the insertion system in binary */
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--stats") == 0)
+			statsflag = true;
+		else if (strcmp(argv[i], "-b") == 0)
+			bflag = true;
+		else {
+			fprintf(stderr, "Error: illegal option '%s'\n", argv[i]);
+			return EXIT_FAILURE;
 		}
+	}
 
-		if (sscanf(buf, "%d", &r.lhs.a) != EOF) {
-			fprintf(stderr, "Line has stuff but can't be parsed:\n	%s\n", buf);
-			return EXIT_FAILURE;
-		}	
+	PairGrammar pg;
 
+	PhaseTimer timer;
+	timer.start("parse");
+	Parser parser;
+	if (!parser.open(0) || !pg.read(parser)) {
+		fprintf(stderr, "Error: %s.\n", parser.error().c_str());
+		return EXIT_FAILURE;
 	}
 
 	// Check that the resulting grammar is valid globally (something we can't do line by line)
+	timer.start("validate");
 	if (!pg.is_valid()) {
-		fprintf(stderr, "Pair grammar is not valid.\n");
+		fprintf(stderr, "Pair grammar is not valid: %s.\n", pg.error().c_str());
 		return EXIT_FAILURE;
 	}
 
-	pg.print_insertion_system();
+	// The insertion system is output as it is computed (in binary, once it is built)
+	timer.start("convert");
+	if (bflag) {
+		if (!pg.insertion_system().write_binary(stdout)) {
+			fprintf(stderr, "Error: cannot write output.\n");
+			return EXIT_FAILURE;
+		}
+	}
+	else {
+		pg.print_insertion_system();
+		fflush(stdout);
+	}
+
+	if (statsflag)
+		timer.write_json(stderr, "pg2is", "");
 	return EXIT_SUCCESS;
 }
 
-
-
-
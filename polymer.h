@@ -0,0 +1,214 @@
+
+#ifndef POLYMER_H
+#define POLYMER_H
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "output.h"
+
+using std::vector;
+
+// Polymer representations used by the simulator. Each stores the sequence
+// of monomers (as monomer type indices) from the left to the right 
+// initiator half and supports
+// inserting a monomer after a position and removing the monomer at a
+// position. A position stays valid as long as every monomer inserted
+// after it was made has been removed again (the simulator undoes
+// insertions in LIFO order).
+
+// Doubly linked list of monomers. Nodes are carved out of large slabs and
+// recycled through a free list (linked through "next"), so a freed node
+// is usually the next one handed out.
+class ListPolymer {
+
+	public:
+		struct Monomer {
+			int type;
+			Monomer* prev;
+			Monomer* next;
+		};
+
+		typedef Monomer* Position;
+
+		ListPolymer() {
+			free_monomers = NULL;
+			slab_used = SLAB_SIZE;
+			_size = 0;
+			in_use = peak_in_use = 0;
+		}
+
+		~ListPolymer() {
+			for (unsigned int i = 0; i < slabs.size(); ++i)
+				free(slabs[i]);
+		}
+
+		void init(int left, int right) {
+			head = new_monomer();
+			head->prev = NULL;
+			head->type = left;
+			head->next = new_monomer();
+			head->next->prev = head;
+			head->next->next = NULL;
+			head->next->type = right;
+			_size = 2;
+		}
+
+		int size() { return _size; }
+		Position first() { return head; }
+		Position position(int index) {
+			Position p = head;
+			for (int i = 0; i < index; ++i)
+				p = p->next;
+			return p;
+		}
+		Position next(Position p) { return p->next; }
+		Position prev(Position p) { return p->prev; }
+		bool is_last(Position p) { return p->next == NULL; }
+		int type(Position p) { return p->type; }
+
+		Position insert_after(Position loc, int t) {
+			Monomer* mon = new_monomer();
+			mon->next = loc->next;
+			loc->next->prev = mon;
+			loc->next = mon;
+			mon->prev = loc;
+			mon->type = t;
+			++_size;
+			return mon;
+		}
+
+		void remove(Position mon) {
+			mon->prev->next = mon->next;
+			mon->next->prev = mon->prev;
+			mon->next = free_monomers;
+			free_monomers = mon;
+			--in_use;
+			--_size;
+		}
+
+		// Most monomers in use at once, and the slabs holding them
+		long long peak_usage() { return peak_in_use; }
+		void print_usage(Output& out) {
+			out << "Peak monomer pool usage: " << (unsigned long long) peak_in_use << " monomers in "
+				<< (unsigned long long) slabs.size() << " slabs of " << SLAB_SIZE << '\n';
+		}
+
+	private:
+		static const int SLAB_SIZE = 65536;
+
+		Monomer* new_monomer() {
+			Monomer* mon;
+			if (free_monomers != NULL) {
+				mon = free_monomers;
+				free_monomers = mon->next;
+			}
+			else {
+				if (slab_used == SLAB_SIZE) {
+					slabs.push_back((Monomer*) malloc(SLAB_SIZE * sizeof(Monomer)));
+					slab_used = 0;
+				}
+				mon = slabs.back() + slab_used++;
+			}
+			if (++in_use > peak_in_use)
+				peak_in_use = in_use;
+			return mon;
+		}
+
+		Monomer* head;
+		int _size;
+		vector<Monomer*> slabs;
+		Monomer* free_monomers;
+		int slab_used; /* nodes handed out from the newest slab */
+		long long in_use, peak_in_use;
+};
+
+// Gap buffer of monomers: one contiguous array with a hole at the most
+// recent insertion or removal. Positions are indices into the sequence.
+// The simulator inserts and removes near the site it is scanning, so
+// moving the hole costs no more than the scan itself, and scans walk
+// memory sequentially instead of chasing pointers.
+class GapPolymer {
+
+	public:
+		typedef int Position;
+
+		GapPolymer() {
+			buf = NULL;
+			capacity = gap_start = gap_end = 0;
+		}
+
+		~GapPolymer() {
+			free(buf);
+		}
+
+		void init(int left, int right) {
+			capacity = 1024;
+			buf = (int*) malloc(capacity * sizeof(int));
+			buf[0] = left;
+			buf[capacity-1] = right;
+			gap_start = 1;
+			gap_end = capacity-1;
+		}
+
+		int size() { return capacity - (gap_end - gap_start); }
+		Position first() { return 0; }
+		Position position(int index) { return index; }
+		Position next(Position p) { return p+1; }
+		Position prev(Position p) { return p-1; }
+		bool is_last(Position p) { return p == size()-1; }
+		int type(Position p) {
+			return p < gap_start ? buf[p] : buf[p + (gap_end - gap_start)];
+		}
+
+		Position insert_after(Position loc, int t) {
+			if (gap_start == gap_end)
+				grow();
+			move_gap(loc+1);
+			buf[gap_start++] = t;
+			return loc+1;
+		}
+
+		void remove(Position p) {
+			move_gap(p+1);
+			--gap_start;
+		}
+
+		// Monomers reserved by the buffer, which only grows
+		long long peak_usage() { return capacity; }
+		void print_usage(Output& out) {
+			out << "Peak gap buffer usage: " << capacity << " monomers reserved" << '\n';
+		}
+
+	private:
+		// Moves the gap to start at position p.
+		void move_gap(Position p) {
+			if (p < gap_start) {
+				int n = gap_start - p;
+				memmove(buf + gap_end - n, buf + p, n * sizeof(int));
+				gap_start -= n;
+				gap_end -= n;
+			}
+			else if (p > gap_start) {
+				int n = p - gap_start;
+				memmove(buf + gap_start, buf + gap_end, n * sizeof(int));
+				gap_start += n;
+				gap_end += n;
+			}
+		}
+
+		void grow() {
+			int tail = capacity - gap_end;
+			capacity *= 2;
+			buf = (int*) realloc(buf, capacity * sizeof(int));
+			memmove(buf + capacity - tail, buf + gap_end, tail * sizeof(int));
+			gap_end = capacity - tail;
+		}
+
+		int* buf;
+		int capacity;
+		int gap_start, gap_end; /* the gap is buf[gap_start .. gap_end-1] */
+};
+
+#endif
+
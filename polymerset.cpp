@@ -0,0 +1,76 @@
+
+#include "polymerset.h"
+#include <algorithm>
+
+using std::equal;
+using std::lock_guard;
+using std::max;
+
+PolymerSet :: PolymerSet() {
+	for (int s = 0; s < (1 << STRIPE_BITS); ++s) {
+		stripes[s].slots.assign(16, Slot());
+		stripes[s].used = 0;
+	}
+}
+
+bool PolymerSet :: insert(unsigned long long hash, const vector<unsigned int>& monomers) {
+	hash = mix_hash(hash);
+	// The top bits pick the stripe and the low bits the slot
+	Stripe& stripe = stripes[hash >> (64 - STRIPE_BITS)];
+	lock_guard<mutex> guard(stripe.lock);
+	unsigned long long mask = stripe.slots.size() - 1;
+	unsigned long long i = hash & mask;
+	for (; stripe.slots[i].offset != 0; i = (i + 1) & mask) {
+		const Slot& slot = stripe.slots[i];
+		if (slot.hash != hash)
+			continue;
+		const unsigned int* stored = &stripe.arena[slot.offset - 1];
+		if (stored[0] == monomers.size() && equal(monomers.begin(), monomers.end(), stored + 1))
+			return false;
+	}
+
+	stripe.slots[i].hash = hash;
+	stripe.slots[i].offset = stripe.arena.size() + 1;
+	stripe.arena.push_back(monomers.size());
+	stripe.arena.insert(stripe.arena.end(), monomers.begin(), monomers.end());
+	if (++stripe.used * 2 > stripe.slots.size())
+		grow(stripe);
+	return true;
+}
+
+// Doubles the stripe's table, keeping it at most half full.
+void PolymerSet :: grow(Stripe& stripe) {
+	vector<Slot> slots(2 * stripe.slots.size(), Slot());
+	unsigned long long mask = slots.size() - 1;
+	for (unsigned int j = 0; j < stripe.slots.size(); ++j) {
+		const Slot& slot = stripe.slots[j];
+		if (slot.offset == 0)
+			continue;
+		unsigned long long i = slot.hash & mask;
+		while (slots[i].offset != 0)
+			i = (i + 1) & mask;
+		slots[i] = slot;
+	}
+	stripe.slots.swap(slots);
+}
+
+PolymerFilter :: PolymerFilter(size_t bytes) : words(max(bytes / 8, (size_t) 1)) {
+	for (size_t i = 0; i < words.size(); ++i)
+		words[i] = 0;
+	bits = 64ULL * words.size();
+}
+
+bool PolymerFilter :: insert(unsigned long long hash) {
+	// Bits hash + i * step for i < HASHES (double hashing), with an odd step
+	hash = mix_hash(hash);
+	unsigned long long step = mix_hash(hash) | 1;
+	bool added = false;
+	for (int i = 0; i < HASHES; ++i) {
+		unsigned long long bit = (hash + i * step) % bits;
+		unsigned long long mask = 1ULL << (bit & 63);
+		if ((words[bit >> 6].fetch_or(mask, std::memory_order_relaxed) & mask) == 0)
+			added = true;
+	}
+	return added;
+}
+
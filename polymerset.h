@@ -0,0 +1,91 @@
+
+#ifndef POLYMERSET_H
+#define POLYMERSET_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+using std::atomic;
+using std::mutex;
+using std::vector;
+
+// Sets of the terminal polymers printed so far, used by simulator --unique
+// to print each distinct polymer once. A polymer is given as its rolling
+// hash and, for an exact set, its sequence of monomers, each as the id of
+// what it prints as (types differing only in their sign print the same).
+//
+// The rolling hash of a polymer is roll_hash() applied to its monomers
+// from left to right, starting from 0. The simulator only inserts at the
+// site it is scanning, so it keeps the hash of the monomers up to the site
+// as the site moves right, saves it with each insertion, and restores it
+// when backtracking; the hash is complete when the site reaches the end.
+inline unsigned long long roll_hash(unsigned long long h, unsigned int id) {
+	return h * 0x9E3779B97F4A7C15ULL + id + 1;
+}
+
+// The low bits of a rolling hash depend only on the low bits of the ids,
+// so the sets mix its bits before using them (splitmix64 finalizer).
+inline unsigned long long mix_hash(unsigned long long h) {
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+	return h ^ (h >> 31);
+}
+
+// Exact set of polymers. The monomers of each polymer are stored once, in
+// an arena of 4-byte ids, and found through an open-addressing table of
+// (hash, arena offset) pairs; polymers with equal hashes are compared
+// monomer by monomer. The set is split into stripes by hash, each
+// with its own lock, so threads adding different polymers rarely wait.
+class PolymerSet {
+
+	public:
+		PolymerSet();
+
+		// Adds the polymer "monomers" with rolling hash "hash", returning
+		// whether it was not in the set already.
+		bool insert(unsigned long long hash, const vector<unsigned int>& monomers);
+
+	private:
+		typedef struct {
+			unsigned long long hash;
+			unsigned long long offset; /* of the polymer's length in the arena, plus one; 0 if empty */
+		} Slot;
+
+		typedef struct {
+			mutex lock;
+			vector<Slot> slots; /* a power of two */
+			unsigned long long used;
+			vector<unsigned int> arena; /* length, then monomers, of each polymer */
+		} Stripe;
+
+		static const int STRIPE_BITS = 6;
+
+		void grow(Stripe& stripe);
+
+		Stripe stripes[1 << STRIPE_BITS];
+};
+
+// Approximate set of polymers in a fixed amount of memory: a Bloom filter
+// of the polymers' hashes. A polymer may be taken for one already in the
+// set (and not printed), more often as the filter fills up, but never the
+// other way around. Lock-free: bits are only ever set, by atomic ORs.
+class PolymerFilter {
+
+	public:
+		PolymerFilter(size_t bytes);
+
+		// Adds the polymer with rolling hash "hash", returning whether it
+		// was (apparently) not in the set already.
+		bool insert(unsigned long long hash);
+
+	private:
+		static const int HASHES = 4; /* bits set per polymer */
+
+		vector<atomic<unsigned long long> > words;
+		unsigned long long bits;
+};
+
+#endif
+
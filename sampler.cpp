@@ -0,0 +1,304 @@
+
+#include "sampler.h"
+#include <cmath>
+
+Sampler::Stats :: Stats() {
+	samples = unfinished = 0;
+	mean = m2 = 0;
+	time_mean = time_m2 = 0;
+	time_min = time_max = 0;
+}
+
+// Adds a sample of size "size" finished at time "time", updating the 
+// means and variances as in Welford's method.
+void Sampler::Stats :: add(unsigned long long size, double time) {
+	++samples;
+	double delta = size - mean;
+	mean += delta / samples;
+	m2 += delta * (size - mean);
+	++sizes[size];
+
+	delta = time - time_mean;
+	time_mean += delta / samples;
+	time_m2 += delta * (time - time_mean);
+	if (samples == 1 || time < time_min)
+		time_min = time;
+	if (samples == 1 || time > time_max)
+		time_max = time;
+}
+
+void Sampler::Stats :: add_unfinished() {
+	++unfinished;
+}
+
+// Combines the means and variances as in Chan et al.'s parallel algorithm.
+void Sampler::Stats :: merge(const Stats& s) {
+	unfinished += s.unfinished;
+	if (s.samples == 0)
+		return;
+	if (samples == 0 || s.time_min < time_min)
+		time_min = s.time_min;
+	if (samples == 0 || s.time_max > time_max)
+		time_max = s.time_max;
+
+	unsigned long long n = samples + s.samples;
+	double delta = s.mean - mean;
+	mean += delta * s.samples / n;
+	m2 += s.m2 + delta * delta * ((double) samples * s.samples / n);
+	delta = s.time_mean - time_mean;
+	time_mean += delta * s.samples / n;
+	time_m2 += s.time_m2 + delta * delta * ((double) samples * s.samples / n);
+	samples = n;
+	for (map<unsigned long long, unsigned long long>::const_iterator it = s.sizes.begin(); it != s.sizes.end(); ++it)
+		sizes[it->first] += it->second;
+}
+
+double Sampler::Stats :: variance() const {
+	return (samples > 1 ? m2 / (samples - 1) : 0);
+}
+
+double Sampler::Stats :: time_variance() const {
+	return (samples > 1 ? time_m2 / (samples - 1) : 0);
+}
+
+static inline unsigned long long rotl(unsigned long long x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+// Seeds the generator with a splitmix64 sequence starting from s.
+void Sampler::Random :: seed(unsigned long long s) {
+	for (int i = 0; i < 4; ++i) {
+		unsigned long long z = (s += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		state[i] = z ^ (z >> 31);
+	}
+}
+
+unsigned long long Sampler::Random :: next() {
+	unsigned long long result = rotl(state[1] * 5, 7) * 9;
+	unsigned long long t = state[1] << 17;
+	state[2] ^= state[0];
+	state[3] ^= state[1];
+	state[1] ^= state[2];
+	state[0] ^= state[3];
+	state[2] ^= t;
+	state[3] = rotl(state[3], 45);
+	return result;
+}
+
+// Returns a number in 0, 1, ..., n-1 (n < 2^32), by Lemire's multiply-shift method.
+unsigned long long Sampler::Random :: below(unsigned long long n) {
+	return ((next() >> 32) * n) >> 32;
+}
+
+double Sampler::Random :: uniform() {
+	return ((next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+Sampler::PropensityTree :: PropensityTree() {
+	tree.assign(65, 0);
+	weights.assign(64, 0);
+	sites.assign(64, -1);
+	used = 0;
+	updates = 0;
+}
+
+// Adds "delta" to the propensity of slot "slot". Every so often the tree
+// is rebuilt from the exact propensities, so rounding errors don't build up.
+void Sampler::PropensityTree :: update(int slot, double delta) {
+	int n = weights.size();
+	if (++updates == 4 * n) {
+		rebuild();
+		return;
+	}
+	for (int i = slot + 1; i <= n; i += i & -i)
+		tree[i] += delta;
+}
+
+// Rebuilds the tree in linear time: each node adds itself to its parent.
+void Sampler::PropensityTree :: rebuild() {
+	int n = weights.size();
+	updates = 0;
+	for (int i = 1; i <= n; ++i)
+		tree[i] = weights[i-1];
+	for (int i = 1; i <= n; ++i) {
+		int parent = i + (i & -i);
+		if (parent <= n)
+			tree[parent] += tree[i];
+	}
+}
+
+// Adds a slot for site "site", returning the slot.
+int Sampler::PropensityTree :: add(int site, double propensity) {
+	int slot;
+	if (!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else {
+		if (used == (int) weights.size()) {
+			weights.resize(2 * used, 0);
+			sites.resize(2 * used, -1);
+			tree.resize(2 * used + 1, 0);
+			rebuild();
+		}
+		slot = used++;
+	}
+	sites[slot] = site;
+	weights[slot] = propensity;
+	update(slot, propensity);
+	return slot;
+}
+
+void Sampler::PropensityTree :: remove(int slot) {
+	double w = weights[slot];
+	weights[slot] = 0;
+	sites[slot] = -1;
+	free_slots.push_back(slot);
+	update(slot, -w);
+}
+
+void Sampler::PropensityTree :: replace(int slot, int site, double propensity) {
+	double w = weights[slot];
+	weights[slot] = propensity;
+	sites[slot] = site;
+	update(slot, propensity - w);
+}
+
+double Sampler::PropensityTree :: total() {
+	double sum = 0;
+	for (int i = weights.size(); i > 0; i -= i & -i)
+		sum += tree[i];
+	return sum;
+}
+
+// Returns the first slot whose prefix sum of propensities reaches x, 
+// for 0 < x <= total(), by descending the tree.
+int Sampler::PropensityTree :: find(double x) {
+	int n = weights.size();
+	int pos = 0;
+	for (int step = n; step > 0; step >>= 1) {
+		if (pos + step <= n && tree[pos + step] < x) {
+			pos += step;
+			x -= tree[pos];
+		}
+	}
+
+	// Rounding can land past the end or on an empty slot
+	if (pos >= used)
+		pos = used - 1;
+	while (pos > 0 && weights[pos] == 0)
+		--pos;
+	while (weights[pos] == 0)
+		++pos;
+	return pos;
+}
+
+int Sampler::PropensityTree :: site(int slot) {
+	return sites[slot];
+}
+
+bool Sampler::PropensityTree :: empty() {
+	return used == (int) free_slots.size();
+}
+
+Sampler :: Sampler(SiteGraph& graph, InsertionSystem& system, unsigned long long seed, 
+	unsigned long long max_insertions, bool kinetic) : graph(graph) {
+	this->seed = seed;
+	this->max_insertions = max_insertions;
+	this->kinetic = kinetic;
+	for (int t = 0; t < system.size(); ++t)
+		rates.push_back(system.type(t).rate);
+
+	max_degree = 0;
+	for (int s = 0; s < graph.size(); ++s) {
+		degree.push_back(graph.insertions(s));
+		if (degree[s] > max_degree)
+			max_degree = degree[s];
+		propensity.push_back(0);
+		for (int i = 0; i < degree[s]; ++i)
+			propensity[s] += rates[graph.insertion(s, i).type];
+	}
+}
+
+// Picks (site, type) pairs uniformly by rejection: a uniformly random open
+// site s is accepted with probability degree[s] / max_degree, and then 
+// each of its insertions is equally likely.
+unsigned long long Sampler :: sample(unsigned long long i, Stats& stats) {
+	Random random;
+	random.seed(seed ^ (i * 0xD1B54A32D192ED03ULL));
+	if (kinetic)
+		return sample_kinetic(random, stats);
+
+	vector<int> open; /* sites of the polymer that allow an insertion */
+	if (degree[graph.root()] > 0)
+		open.push_back(graph.root());
+	unsigned long long insertions = 0;
+	while (!open.empty()) {
+		if (insertions == max_insertions) {
+			stats.add_unfinished();
+			return insertions;
+		}
+
+		int k = random.below(open.size());
+		int s = open[k];
+		int r = random.below(max_degree);
+		if (r >= degree[s])
+			continue;
+
+		const SiteGraph::Insertion& e = graph.insertion(s, r);
+		open[k] = open.back();
+		open.pop_back();
+		if (degree[e.left] > 0)
+			open.push_back(e.left);
+		if (degree[e.right] > 0)
+			open.push_back(e.right);
+		++insertions;
+	}
+	stats.add(insertions + 2, 0);
+	return insertions;
+}
+
+// Gillespie's direct method: the next insertion happens after an 
+// exponentially distributed time with the total propensity as its rate,
+// at a site chosen in proportion to its propensity, with a type chosen
+// in proportion to its rate.
+unsigned long long Sampler :: sample_kinetic(Random& random, Stats& stats) {
+	PropensityTree tree;
+	if (degree[graph.root()] > 0)
+		tree.add(graph.root(), propensity[graph.root()]);
+	double time = 0;
+	unsigned long long insertions = 0;
+	while (!tree.empty()) {
+		if (insertions == max_insertions) {
+			stats.add_unfinished();
+			return insertions;
+		}
+
+		double total = tree.total();
+		time -= log(random.uniform()) / total;
+		int slot = tree.find(random.uniform() * total);
+		int s = tree.site(slot);
+
+		double x = random.uniform() * propensity[s];
+		int k = 0;
+		for (; k < degree[s] - 1; ++k) {
+			x -= rates[graph.insertion(s, k).type];
+			if (x <= 0)
+				break;
+		}
+		const SiteGraph::Insertion& e = graph.insertion(s, k);
+
+		if (degree[e.left] > 0)
+			tree.replace(slot, e.left, propensity[e.left]);
+		else
+			tree.remove(slot);
+		if (degree[e.right] > 0)
+			tree.add(e.right, propensity[e.right]);
+		++insertions;
+	}
+	stats.add(insertions + 2, time);
+	return insertions;
+}
+
@@ -0,0 +1,100 @@
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "sitegraph.h"
+#include <map>
+#include <vector>
+
+using std::map;
+using std::vector;
+
+// Monte Carlo sampling of terminal polymers: starting from the initiator,
+// repeatedly insert a monomer chosen uniformly at random from all the
+// (site, monomer type) pairs of the polymer that allow an insertion. 
+// Only the sizes of the polymers are kept, so a polymer is tracked as the
+// multiset of its sites that still allow an insertion.
+//
+// In kinetic mode, each (site, type) pair instead fires after an 
+// exponentially distributed time with the type's rate, simulated with
+// Gillespie's direct method, and the time at which the polymer is 
+// finished is kept as well.
+class Sampler {
+
+	public:
+		// Summary of a set of samples. Merging summaries of disjoint sets
+		// of samples gives the summary of their union.
+		class Stats {
+			public:
+				Stats();
+				void add(unsigned long long size, double time);
+				void add_unfinished();
+				void merge(const Stats& s);
+				double variance() const;
+
+				unsigned long long samples; /* terminal polymers sampled */
+				unsigned long long unfinished; /* samples stopped at the insertion limit */
+				double mean; /* mean polymer size */
+				double m2; /* sum of squared differences from the mean size */
+				map<unsigned long long, unsigned long long> sizes; /* polymers of each size */
+				double time_mean, time_m2; /* as mean and m2, for completion times */
+				double time_min, time_max;
+				double time_variance() const;
+		};
+
+		Sampler(SiteGraph& graph, InsertionSystem& system, unsigned long long seed, 
+			unsigned long long max_insertions, bool kinetic);
+
+		// Samples terminal polymer number i, adding it to "stats", and returns
+		// the number of insertions made. The same seed and i always give the 
+		// same polymer, whichever thread samples it.
+		unsigned long long sample(unsigned long long i, Stats& stats);
+
+	private:
+		// xoshiro256** pseudorandom generator
+		class Random {
+			public:
+				void seed(unsigned long long s);
+				unsigned long long next();
+				unsigned long long below(unsigned long long n);
+				double uniform(); /* in (0, 1] */
+			private:
+				unsigned long long state[4];
+		};
+
+		// Fenwick tree of the propensities (total rates) of the open sites,
+		// one slot per site. Freed slots are reused. 
+		class PropensityTree {
+			public:
+				PropensityTree();
+				int add(int site, double propensity);
+				void remove(int slot);
+				void replace(int slot, int site, double propensity);
+				double total();
+				int find(double x); /* slot where the prefix sum of propensities passes x */
+				int site(int slot);
+				bool empty();
+			private:
+				void update(int slot, double delta);
+				void rebuild();
+				vector<double> tree, weights;
+				vector<int> sites;
+				vector<int> free_slots;
+				int used; /* slots ever used */
+				int updates; /* since the tree was last rebuilt */
+		};
+
+		unsigned long long sample_kinetic(Random& random, Stats& stats);
+
+		SiteGraph& graph;
+		unsigned long long seed;
+		unsigned long long max_insertions;
+		vector<int> degree; /* insertions(s) for each site s */
+		int max_degree;
+		bool kinetic;
+		vector<double> propensity; /* total rate of the insertions of each site */
+		vector<double> rates; /* rate of each monomer type */
+};
+
+#endif
+
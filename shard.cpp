@@ -0,0 +1,73 @@
+
+#include "shard.h"
+#include <cstdio>
+#include <cstring>
+
+ShardIndex :: ShardIndex() {
+	shard = 0;
+	shards = 1;
+	depth = 0;
+	fingerprint = units = polymers = 0;
+}
+
+bool ShardIndex :: write(const string& file) {
+	FILE* f = fopen(file.c_str(), "w");
+	if (f == NULL) {
+		_error = "cannot write shard index '" + file + "'";
+		return false;
+	}
+	fprintf(f, "# Shard index written by simulator --shard, read by shardmerge\n");
+	fprintf(f, "shard %d/%d\n", shard, shards);
+	fprintf(f, "depth %d\n", depth);
+	fprintf(f, "fingerprint %llu\n", fingerprint);
+	fprintf(f, "units %llu\n", units);
+	fprintf(f, "polymers %llu\n", polymers);
+	for (unsigned int i = 0; i < unit_polymers.size(); ++i)
+		fprintf(f, "unit %llu %llu\n", unit_polymers[i].first, unit_polymers[i].second);
+	bool ok = !ferror(f);
+	if (fclose(f) != 0 || !ok) {
+		_error = "cannot write shard index '" + file + "'";
+		return false;
+	}
+	return true;
+}
+
+bool ShardIndex :: read(const string& file) {
+	FILE* f = fopen(file.c_str(), "r");
+	if (f == NULL) {
+		_error = "cannot open shard index '" + file + "'";
+		return false;
+	}
+
+	char comment[128];
+	bool ok = (fgets(comment, sizeof comment, f) != NULL && strncmp(comment, "# Shard index", 13) == 0
+		&& fscanf(f, " shard %d/%d", &shard, &shards) == 2
+		&& fscanf(f, " depth %d", &depth) == 1
+		&& fscanf(f, " fingerprint %llu", &fingerprint) == 1
+		&& fscanf(f, " units %llu", &units) == 1
+		&& fscanf(f, " polymers %llu", &polymers) == 1
+		&& shards > 0 && shard >= 0 && shard < shards);
+
+	// Units must be the shard's own, in increasing order
+	unit_polymers.clear();
+	unsigned long long u, n, total = 0;
+	while (ok && fscanf(f, " unit %llu %llu", &u, &n) == 2) {
+		if (u >= units || u % shards != (unsigned long long) shard
+			|| (!unit_polymers.empty() && u <= unit_polymers.back().first))
+			ok = false;
+		unit_polymers.push_back(std::make_pair(u, n));
+		total += n;
+	}
+	ok = ok && fscanf(f, " %c", comment) == EOF && total == polymers;
+	fclose(f);
+	if (!ok) {
+		_error = "'" + file + "' is not a shard index";
+		return false;
+	}
+	return true;
+}
+
+const string& ShardIndex :: error() {
+	return _error;
+}
+
@@ -0,0 +1,51 @@
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::string;
+using std::vector;
+
+// Index of the output of one shard of a sharded enumeration (simulator
+// --shard i/N, see Simulator::set_shard()), from which shardmerge puts
+// the outputs of all N shards back into search order.
+//
+// The search tree is cut into units, numbered in search order: the
+// subtrees rooted at the insertions at depth "depth", and the terminal
+// polymers found above that depth. Shard i enumerates the units u with
+// u mod N = i. Its index lists, for each of its units that found any
+// terminal polymers, the unit and the number of polymers (output lines).
+//
+// The index is a text file:
+//   # Shard index written by simulator --shard, read by shardmerge
+//   shard i/N
+//   depth D
+//   fingerprint F   (InsertionSystem::fingerprint())
+//   units U         (units in the whole search tree)
+//   polymers P      (terminal polymers found by this shard)
+//   unit u n        (one line per unit with polymers, in order)
+class ShardIndex {
+
+	public:
+		ShardIndex();
+		bool write(const string& file);
+		bool read(const string& file);
+		const string& error();
+
+		int shard, shards;
+		int depth;
+		unsigned long long fingerprint;
+		unsigned long long units;
+		unsigned long long polymers;
+		vector<pair<unsigned long long, unsigned long long> > unit_polymers; /* (unit, polymers) */
+
+	private:
+		string _error;
+};
+
+#endif
+
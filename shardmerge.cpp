@@ -0,0 +1,135 @@
+/*
+Program for merging the outputs of a sharded enumeration (simulator
+--shard i/N, see shard.h) into the output of a single run.
+
+The program takes the index and output file of each of the N shards,
+in any order, as command-line arguments:
+	shardmerge INDEX0 OUTPUT0 INDEX1 OUTPUT1 ...
+and prints the terminal polymers of all shards to stdout, in the order
+the unsharded search finds them.
+
+Options:
+--stats   print the phase times and the polymers of each shard as JSON to stderr
+*/
+
+#include "output.h"
+#include "shard.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Copies "lines" lines from "in" to "out", returning false if "in" ends first.
+bool copy_lines(FILE* in, FILE* out, unsigned long long lines) {
+	for (unsigned long long i = 0; i < lines; ) {
+		int c = getc(in);
+		if (c == EOF)
+			return false;
+		putc(c, out);
+		if (c == '\n')
+			++i;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	bool statsflag = false; /* print phase times and polymers as JSON */
+	vector<string> files;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--stats") == 0)
+			statsflag = true;
+		else
+			files.push_back(argv[i]);
+	}
+	if (files.empty() || files.size() % 2 != 0) {
+		fprintf(stderr, "Usage: shardmerge [--stats] INDEX0 OUTPUT0 INDEX1 OUTPUT1 ...\n");
+		return EXIT_FAILURE;
+	}
+
+	PhaseTimer timer;
+	timer.start("read");
+
+	// Each shard's index and output, placed by shard number
+	int shards = files.size() / 2;
+	vector<ShardIndex> indices(shards);
+	vector<FILE*> outputs(shards, (FILE*) NULL);
+	vector<string> output_files(shards);
+	ShardIndex first; /* the first index given, which the others must match */
+	for (int k = 0; k < shards; ++k) {
+		ShardIndex index;
+		if (!index.read(files[2*k])) {
+			fprintf(stderr, "Error: %s.\n", index.error().c_str());
+			return EXIT_FAILURE;
+		}
+		if (index.shards != shards) {
+			fprintf(stderr, "Error: '%s' is shard %d of %d, but %d shards were given.\n",
+				files[2*k].c_str(), index.shard, index.shards, shards);
+			return EXIT_FAILURE;
+		}
+		if (outputs[index.shard] != NULL) {
+			fprintf(stderr, "Error: shard %d was given twice.\n", index.shard);
+			return EXIT_FAILURE;
+		}
+		if (k == 0)
+			first = index;
+		else if (index.depth != first.depth || index.fingerprint != first.fingerprint || index.units != first.units) {
+			fprintf(stderr, "Error: '%s' is a shard of a different search.\n", files[2*k].c_str());
+			return EXIT_FAILURE;
+		}
+		FILE* f = fopen(files[2*k+1].c_str(), "r");
+		if (f == NULL) {
+			fprintf(stderr, "Error: cannot open '%s'.\n", files[2*k+1].c_str());
+			return EXIT_FAILURE;
+		}
+		indices[index.shard] = index;
+		outputs[index.shard] = f;
+		output_files[index.shard] = files[2*k+1];
+	}
+
+	// Take the units' polymers from their shards in unit order
+	timer.start("merge");
+	vector<unsigned int> next(shards, 0); /* next unit_polymers entry of each shard */
+	unsigned long long units = first.units;
+	unsigned long long polymers = 0;
+	for (unsigned long long u = 0; u < units; ++u) {
+		int s = u % shards;
+		ShardIndex& index = indices[s];
+		if (next[s] == index.unit_polymers.size() || index.unit_polymers[next[s]].first != u)
+			continue;
+		unsigned long long lines = index.unit_polymers[next[s]++].second;
+		if (!copy_lines(outputs[s], stdout, lines)) {
+			fprintf(stderr, "Error: '%s' has fewer polymers than its index lists.\n", output_files[s].c_str());
+			return EXIT_FAILURE;
+		}
+		polymers += lines;
+	}
+	for (int s = 0; s < shards; ++s) {
+		if (getc(outputs[s]) != EOF) {
+			fprintf(stderr, "Error: '%s' has more polymers than its index lists.\n", output_files[s].c_str());
+			return EXIT_FAILURE;
+		}
+		fclose(outputs[s]);
+	}
+	if (fflush(stdout) != 0) {
+		fprintf(stderr, "Error: cannot write output.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (statsflag) {
+		Output fields;
+		fields << "  \"shards\": " << shards << ",\n"
+			<< "  \"units\": " << units << ",\n"
+			<< "  \"terminal_polymers\": " << polymers << ",\n"
+			<< "  \"shard_polymers\": [";
+		for (int s = 0; s < shards; ++s)
+			fields << (s > 0 ? ", " : "") << indices[s].polymers;
+		fields << "]";
+		timer.write_json(stderr, "shardmerge", fields.str());
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,805 @@
+
+#include "simulation.h"
+#include "polymer.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <thread>
+
+using std::cerr;
+using std::equal;
+using std::lock_guard;
+using std::make_pair;
+using std::map;
+using std::max;
+using std::thread;
+using std::unique_lock;
+
+#ifdef INSERTION_STATS
+// Counters of the search running on this thread, added to the simulator's
+// total when the search finishes. Without INSERTION_STATS (make STATS=1)
+// the COUNT macros compile to nothing.
+static thread_local Simulator::Counters thread_counters;
+
+#define COUNT(field) (++thread_counters.field)
+#define COUNT_IF(field, condition) (thread_counters.field += (condition) ? 1 : 0)
+#define COUNT_MAX(field, n) (thread_counters.field = max(thread_counters.field, (unsigned long long) (n)))
+#define COUNT_TYPE(t) count_type(t)
+#define MERGE_COUNTERS() merge_counters()
+#else
+#define COUNT(field)
+#define COUNT_IF(field, condition)
+#define COUNT_MAX(field, n)
+#define COUNT_TYPE(t)
+#define MERGE_COUNTERS()
+#endif
+
+Simulator :: Simulator(InsertionSystem& system) : system(system) {
+	sizes_only = false;
+	verbose = false;
+	representation = "gap";
+	threads = 1;
+	streaming = false;
+	checkpoint_interval = 10;
+	resuming = false;
+	shard_depth = 0;
+	next_unit = 0;
+	polymer_units = 0;
+	unique = false;
+	filter_bytes = 0;
+	unique_set = NULL;
+	unique_filter = NULL;
+	output = NULL;
+	_polymers_found = 0;
+	_output_resumed = 0;
+	_peak_pool_usage = 0;
+	total_counters = Counters();
+	workers = NULL;
+	idle_workers = 0;
+	queued_tasks = 0;
+	unfinished_tasks = 0;
+}
+
+Simulator :: ~Simulator() {
+	for (unsigned int i = 0; i < tasks.size(); ++i)
+		delete tasks[i];
+	delete[] workers;
+	delete unique_set;
+	delete unique_filter;
+}
+
+void Simulator :: set_sizes_only(bool sizes_only) {
+	this->sizes_only = sizes_only;
+}
+
+void Simulator :: set_verbose(bool verbose) {
+	this->verbose = verbose;
+}
+
+void Simulator :: set_representation(const string& name) {
+	representation = name;
+}
+
+void Simulator :: set_threads(int threads, bool streaming) {
+	this->threads = threads;
+	this->streaming = streaming;
+}
+
+void Simulator :: set_checkpoint(const string& file, int interval) {
+	checkpoint_file = file;
+	checkpoint_interval = interval;
+}
+
+void Simulator :: set_shard(int shard, int shards, int depth) {
+	index.shard = shard;
+	index.shards = shards;
+	index.depth = depth;
+}
+
+void Simulator :: set_unique(bool unique, size_t filter_bytes) {
+	this->unique = unique;
+	this->filter_bytes = filter_bytes;
+}
+
+unsigned long long Simulator :: polymers_found() {
+	return _polymers_found;
+}
+
+unsigned long long Simulator :: output_resumed() {
+	return _output_resumed;
+}
+
+unsigned long long Simulator :: peak_pool_usage() {
+	return _peak_pool_usage;
+}
+
+const Simulator::Counters& Simulator :: counters() {
+	return total_counters;
+}
+
+const ShardIndex& Simulator :: shard_index() {
+	return index;
+}
+
+const string& Simulator :: error() {
+	return _error;
+}
+
+#ifdef INSERTION_STATS
+void Simulator :: count_type(int t) {
+	if (thread_counters.type_hits.empty())
+		thread_counters.type_hits.assign(system.size() + 2, 0);
+	++thread_counters.type_hits[t];
+}
+
+// Adds this thread's counters to the total.
+void Simulator :: merge_counters() {
+	lock_guard<mutex> guard(counters_lock);
+	Counters& c = thread_counters;
+	Counters& t = total_counters;
+	t.candidate_calls += c.candidate_calls;
+	t.candidate_hits += c.candidate_hits;
+	t.insertions += c.insertions;
+	t.backtracks += c.backtracks;
+	t.terminal_polymers += c.terminal_polymers;
+	t.duplicate_polymers += c.duplicate_polymers;
+	t.max_depth = max(t.max_depth, c.max_depth);
+	t.peak_size = max(t.peak_size, c.peak_size);
+	if (t.type_hits.empty())
+		t.type_hits.assign(system.size() + 2, 0);
+	for (unsigned int i = 0; i < c.type_hits.size(); ++i)
+		t.type_hits[i] += c.type_hits[i];
+	c = Counters();
+}
+#endif
+
+// Returns the first monomer type >= from insertable into the site
+// to the right of monomer "site", or -1 if there is none.
+template <class Polymer>
+int Simulator :: candidate(Polymer& polymer, typename Polymer::Position site, int from) {
+	int t = system.candidate(polymer.type(site), polymer.type(polymer.next(site)), from);
+	COUNT(candidate_calls);
+	COUNT_IF(candidate_hits, t != -1);
+	return t;
+}
+
+template <class Polymer>
+void Simulator :: print_polymer(Output& out, Polymer& polymer) {
+	if (sizes_only) {
+		out << "Polymer size: " << polymer.size() << '\n';
+		return;
+	}
+
+	typename Polymer::Position cur = polymer.first();
+	while (true) {
+		system.print_monomer(out, system.type(polymer.type(cur)), false);
+		out << ' ';
+		if (polymer.is_last(cur))
+			break;
+		cur = polymer.next(cur);
+	}
+
+	out << '\n';
+}
+
+template <class Polymer>
+typename Polymer::Position Simulator :: insert_monomer(Output& out, Polymer& polymer, int type, typename Polymer::Position loc) {
+	if (verbose) {
+		out << "Inserting ";
+		system.print_monomer(out, system.type(type), true);
+		out << " into site ";
+		system.print_monomer(out, system.type(polymer.type(loc)), false);
+		system.print_monomer(out, system.type(polymer.type(polymer.next(loc))), false);
+		out << '\n';
+	}
+
+	return polymer.insert_after(loc, type);
+}
+
+Simulator::Task* Simulator :: get_task(int id) {
+	lock_guard<mutex> guard(tasks_lock);
+	return tasks[id];
+}
+
+int Simulator :: new_task(Task* task) {
+	lock_guard<mutex> guard(tasks_lock);
+	tasks.push_back(task);
+	return tasks.size() - 1;
+}
+
+// Moves the remaining candidates of the oldest choice point in
+// "insertions" to a new task. Frames below "checked" are known to have
+// no remaining candidates, which doesn't change while they are on the stack.
+template <class Polymer>
+void Simulator :: donate(int w, vector<Insertion<Polymer> >& insertions, unsigned int& checked) {
+	for (unsigned int f = checked; f < insertions.size(); ++f, ++checked) {
+		Insertion<Polymer>& frame = insertions[f];
+		if (frame.donated != -1 || system.candidate(frame.left, frame.right, frame.type+1) == -1)
+			continue;
+
+		Task* task = new Task;
+		for (unsigned int i = 0; i < f; ++i)
+			task->prefix.push_back(make_pair(insertions[i].index, insertions[i].type));
+		task->site_index = frame.index - 1;
+		task->type = frame.type + 1;
+		task->site_insertable = true;
+		task->resumed = false;
+		frame.donated = new_task(task);
+
+		{
+			lock_guard<mutex> guard(pool_lock);
+			++unfinished_tasks;
+		}
+		{
+			lock_guard<mutex> guard(workers[w].lock);
+			workers[w].tasks.push_back(frame.donated);
+		}
+		{
+			// Under pool_lock, so an idle worker can't check queued_tasks
+			// between the increment and the notification and miss both
+			lock_guard<mutex> guard(pool_lock);
+			++queued_tasks;
+			pool_wakeup.notify_one();
+		}
+		return;
+	}
+}
+
+void Simulator :: flush_output(Output& out) {
+	lock_guard<mutex> guard(output_lock);
+	*output << out.str();
+	out.clear();
+}
+
+// Checkpoints hold the search state of a single-threaded run:
+//   8 bytes    "ISCKPT01"
+//   8 bytes    fingerprint of the insertion system
+//   8 bytes    terminal polymers found so far
+//   8 bytes    bytes of output written so far
+//   3 x 4      site_index, type, site_insertable
+//   4 bytes    number of insertions n
+//   n x 2 x 4  (index, type) of each insertion
+// in native byte order.
+static const char CHECKPOINT_MAGIC[8] = {'I', 'S', 'C', 'K', 'P', 'T', '0', '1'};
+
+// Saves the search state to checkpoint_file. The state is written to a
+// temporary file that then replaces the checkpoint, so a crash while
+// saving leaves the previous checkpoint intact.
+template <class Polymer>
+void Simulator :: save_checkpoint(vector<Insertion<Polymer> >& insertions, unsigned long long found,
+	int site_index, int type, bool site_insertable) {
+	unsigned long long header[3] = {system.fingerprint(), found, _output_resumed + output->written()};
+	int state[4] = {site_index, type, site_insertable, (int) insertions.size()};
+	vector<int> stack(2 * insertions.size());
+	for (unsigned int i = 0; i < insertions.size(); ++i) {
+		stack[2*i] = insertions[i].index;
+		stack[2*i+1] = insertions[i].type;
+	}
+
+	string temp = checkpoint_file + ".tmp";
+	FILE* f = fopen(temp.c_str(), "wb");
+	bool ok = (f != NULL
+		&& fwrite(CHECKPOINT_MAGIC, sizeof CHECKPOINT_MAGIC, 1, f) == 1
+		&& fwrite(header, sizeof header, 1, f) == 1
+		&& fwrite(state, sizeof state, 1, f) == 1
+		&& fwrite(stack.data(), sizeof(int), stack.size(), f) == stack.size());
+	if (f != NULL && fclose(f) != 0)
+		ok = false;
+	if (!ok || rename(temp.c_str(), checkpoint_file.c_str()) != 0)
+		cerr << "Warning: cannot write checkpoint file '" << checkpoint_file << "'.\n";
+}
+
+bool Simulator :: resume() {
+	FILE* f = fopen(checkpoint_file.c_str(), "rb");
+	if (f == NULL) {
+		_error = "cannot open checkpoint file '" + checkpoint_file + "'";
+		return false;
+	}
+
+	char magic[8];
+	unsigned long long header[3];
+	int state[4];
+	bool ok = (fread(magic, sizeof magic, 1, f) == 1
+		&& equal(magic, magic + 8, CHECKPOINT_MAGIC)
+		&& fread(header, sizeof header, 1, f) == 1
+		&& fread(state, sizeof state, 1, f) == 1
+		&& state[3] >= 0);
+	vector<int> stack(ok ? 2 * state[3] : 0);
+	ok = ok && fread(stack.data(), sizeof(int), stack.size(), f) == stack.size();
+	fclose(f);
+	if (!ok) {
+		_error = "'" + checkpoint_file + "' is not a checkpoint file";
+		return false;
+	}
+	if (header[0] != system.fingerprint()) {
+		_error = "checkpoint file '" + checkpoint_file + "' was saved for a different insertion system";
+		return false;
+	}
+
+	_polymers_found = header[1];
+	_output_resumed = header[2];
+	resumed.site_index = state[0];
+	resumed.type = state[1];
+	resumed.site_insertable = state[2];
+	resumed.resumed = true;
+	resumed.prefix.clear();
+	for (int i = 0; i < state[3]; ++i)
+		resumed.prefix.push_back(make_pair(stack[2*i], stack[2*i+1]));
+	resuming = true;
+	return true;
+}
+
+// In a sharded search, notes the insertion just about to be made at the
+// shard depth as the next unit, and returns whether it is this shard's.
+bool Simulator :: shard_subtree() {
+	return next_unit++ % index.shards == (unsigned long long) index.shard;
+}
+
+// In a sharded search, returns whether the terminal polymer just found
+// at insertion depth "depth" is this shard's (either a unit of its own,
+// above the shard depth, or in the current unit), noting it in the index.
+bool Simulator :: shard_polymer(unsigned int depth) {
+	unsigned long long unit = next_unit - 1; /* the subtree being searched */
+	if (depth < (unsigned int) shard_depth) {
+		unit = next_unit;
+		++polymer_units;
+		if (!shard_subtree())
+			return false;
+	}
+	if (index.unit_polymers.empty() || index.unit_polymers.back().first != unit)
+		index.unit_polymers.push_back(make_pair(unit, 0ULL));
+	++index.unit_polymers.back().second;
+	return true;
+}
+
+// With --unique, adds the terminal polymer with rolling hash "hash" to the
+// polymers printed so far, returning whether it is new.
+template <class Polymer>
+bool Simulator :: unique_polymer(Polymer& polymer, unsigned long long hash) {
+	if (unique_filter != NULL)
+		return unique_filter->insert(hash);
+
+	static thread_local vector<unsigned int> monomers;
+	monomers.clear();
+	get_print_ids(polymer, monomers);
+	return unique_set->insert(hash, monomers);
+}
+
+// Appends the print ids of the polymer's monomers to "ids".
+template <class Polymer>
+void Simulator :: get_print_ids(Polymer& polymer, vector<unsigned int>& ids) {
+	typename Polymer::Position cur = polymer.first();
+	while (true) {
+		ids.push_back(print_id[polymer.type(cur)]);
+		if (polymer.is_last(cur))
+			break;
+		cur = polymer.next(cur);
+	}
+}
+
+// With --unique and ordered output, prints the terminal polymer to a piece
+// of the task's output of its own, and keeps what print_task_output()
+// needs to tell whether it was printed already.
+template <class Polymer>
+void Simulator :: keep_polymer(Task& task, Output& out, Polymer& polymer, unsigned long long hash) {
+	if (out.size() > 0) {
+		task.pieces.push_back(out.str());
+		task.children.push_back(-1);
+		out.clear();
+	}
+	print_polymer(out, polymer);
+	task.polymer_pieces.push_back(task.pieces.size());
+	task.pieces.push_back(out.str());
+	task.children.push_back(-1);
+	out.clear();
+
+	task.polymer_hashes.push_back(hash);
+	if (unique_set != NULL) {
+		task.polymer_ids.push_back(polymer.size());
+		get_print_ids(polymer, task.polymer_ids);
+	}
+}
+
+// Adds kept polymer k of the task, whose print ids (if any) start at
+// "offset" in polymer_ids, to the polymers printed so far, returning
+// whether it is new. Moves "offset" past its print ids.
+bool Simulator :: unique_kept_polymer(Task& task, unsigned int k, size_t& offset) {
+	if (unique_filter != NULL)
+		return unique_filter->insert(task.polymer_hashes[k]);
+
+	unsigned int length = task.polymer_ids[offset];
+	vector<unsigned int> monomers(task.polymer_ids.begin() + offset + 1,
+		task.polymer_ids.begin() + offset + 1 + length);
+	offset += length + 1;
+	return unique_set->insert(task.polymer_hashes[k], monomers);
+}
+
+// Enumerates the terminal polymers of the subtree of "task", printing
+// them to "out". "w" is the worker running the task, or -1 if the
+// simulation is single-threaded.
+template <class Polymer>
+void Simulator :: simulate(Polymer& polymer, Task& task, Output& out, int w) {
+	vector<Insertion<Polymer> > insertions;
+	Insertion<Polymer> insert;
+	for (unsigned int i = 0; i < task.prefix.size(); ++i) {
+		typename Polymer::Position loc = polymer.position(task.prefix[i].first - 1);
+		insert.index = task.prefix[i].first;
+		insert.type = task.prefix[i].second;
+		insert.left = polymer.type(loc);
+		insert.right = polymer.type(polymer.next(loc));
+		insert.monomer = polymer.insert_after(loc, insert.type);
+		insert.donated = -1;
+		insert.hash = 0;
+		insertions.push_back(insert);
+	}
+	unsigned long long hash = 0; /* for --unique, rolling hash of the monomers up to the site */
+	if (unique) {
+		// Insertions are made to the right of earlier insertions' sites,
+		// so the monomers up to those sites are as they were
+		vector<unsigned long long> hashes; /* of the monomers up to each position */
+		typename Polymer::Position cur = polymer.first();
+		hashes.push_back(roll_hash(0, print_id[polymer.type(cur)]));
+		for (int i = 1; i <= task.site_index; ++i) {
+			cur = polymer.next(cur);
+			hashes.push_back(roll_hash(hashes.back(), print_id[polymer.type(cur)]));
+		}
+		for (unsigned int i = 0; i < insertions.size(); ++i)
+			insertions[i].hash = hashes[insertions[i].index - 1];
+		hash = hashes[task.site_index];
+	}
+	unsigned int base = (task.resumed ? 0 : task.prefix.size());
+	typename Polymer::Position site = polymer.position(task.site_index);
+	int site_index = task.site_index;
+	int type = (task.resumed ? task.type : candidate(polymer, site, task.type));
+	bool site_insertable = task.site_insertable;
+	unsigned int steps = 0;
+	unsigned int checked = base; /* frames known to have nothing to donate */
+	unsigned long long found = 0; /* terminal polymers found by this call */
+	time_t next_checkpoint = time(NULL) + checkpoint_interval;
+
+	while (insertions.size() != base || type != -1) {
+		// Give away work if another worker has run out
+		if (w != -1 && (++steps & 1023) == 0 && idle_workers > 0 && queued_tasks == 0)
+			donate(w, insertions, checked);
+
+		// Save the search state every checkpoint_interval seconds,
+		// once everything found so far has been written out
+		if (w == -1 && !checkpoint_file.empty() && (++steps & 4095) == 0 && time(NULL) >= next_checkpoint) {
+			out.flush();
+			save_checkpoint(insertions, _polymers_found + found, site_index, type, site_insertable);
+			next_checkpoint = time(NULL) + checkpoint_interval;
+		}
+
+		// if you've reached the end
+		if (polymer.is_last(site)) {
+			bool print = (shard_depth == 0 || shard_polymer(insertions.size()));
+			if (print && unique && w != -1 && !streaming) {
+				// Which of equal polymers is printed must not depend on
+				// the timing of the threads, so duplicates are found in
+				// search order, by print_task_output()
+				keep_polymer(task, out, polymer, hash);
+				print = false;
+			}
+			else if (print && unique && !unique_polymer(polymer, hash)) {
+				// printed already, by way of other insertions
+				COUNT(duplicate_polymers);
+				print = false;
+			}
+			if (print) {
+				if (verbose)
+					out << "Terminal polymer:" << '\n';
+				// print the polymer and pop the stack
+				print_polymer(out, polymer);
+				COUNT(terminal_polymers);
+				++found;
+				if (verbose)
+					out << "------------------------------\n";
+			}
+			type = -1;
+			site_insertable = true;
+		}
+
+		// roll over to next site
+		if (type == -1) {
+			if (site_insertable) {
+				// pop the stack
+				COUNT(backtracks);
+				Insertion<Polymer>& top = insertions.back();
+				site = polymer.prev(top.monomer);
+				site_index = top.index - 1;
+				polymer.remove(top.monomer);
+				hash = top.hash;
+				if (top.donated != -1) {
+					// the remaining candidates were donated, so skip them
+					if (!streaming) {
+						// workers always print to an in-memory Output
+						task.pieces.push_back(out.str());
+						task.children.push_back(top.donated);
+						out.clear();
+					}
+					type = -1;
+				}
+				else
+					type = candidate(polymer, site, top.type+1);
+				insertions.pop_back();
+				if (checked > insertions.size())
+					checked = insertions.size();
+				site_insertable = true;
+			}
+			else {
+				// continue on to the next site
+				site = polymer.next(site);
+				++site_index;
+				if (unique)
+					hash = roll_hash(hash, print_id[polymer.type(site)]);
+				site_insertable = false;
+				if (!polymer.is_last(site))
+					type = candidate(polymer, site, 0);
+				else
+					type = 0;
+			}
+			continue;
+		}
+
+		// skip the subtrees of other shards, as if searched and popped
+		if ((int) insertions.size() + 1 == shard_depth && !shard_subtree()) {
+			type = candidate(polymer, site, type+1);
+			site_insertable = true;
+			continue;
+		}
+
+		// the usual case: insert the next candidate monomer
+		insert.type = type;
+		insert.index = site_index + 1;
+		insert.left = polymer.type(site);
+		insert.right = polymer.type(polymer.next(site));
+		insert.donated = -1;
+		insert.hash = hash;
+		insert.monomer = insert_monomer(out, polymer, type, site);
+		insertions.push_back(insert);
+		COUNT(insertions);
+		COUNT_TYPE(type);
+		COUNT_MAX(max_depth, insertions.size());
+		COUNT_MAX(peak_size, polymer.size());
+
+		type = candidate(polymer, site, 0);
+		site_insertable = false;
+
+		if (w != -1 && streaming && out.size() > (1 << 16))
+			flush_output(out);
+	}
+
+	_polymers_found += found;
+	MERGE_COUNTERS();
+	{
+		lock_guard<mutex> guard(counters_lock);
+		_peak_pool_usage = max(_peak_pool_usage, (unsigned long long) polymer.peak_usage());
+	}
+
+	if (verbose)
+		polymer.print_usage(out);
+}
+
+template <class Polymer>
+void Simulator :: work(int w) {
+	Output out;
+	while (true) {
+		// Take a task from the back of our own deque, or steal one from the front of another's.
+		int id = -1;
+		for (int i = 0; i < threads && id == -1; ++i) {
+			Worker& victim = workers[(w + i) % threads];
+			lock_guard<mutex> guard(victim.lock);
+			if (!victim.tasks.empty()) {
+				if (i == 0) {
+					id = victim.tasks.back();
+					victim.tasks.pop_back();
+				}
+				else {
+					id = victim.tasks.front();
+					victim.tasks.pop_front();
+				}
+				--queued_tasks;
+			}
+		}
+
+		if (id == -1) {
+			unique_lock<mutex> guard(pool_lock);
+			if (unfinished_tasks == 0)
+				return;
+			++idle_workers;
+			pool_wakeup.wait(guard, [this]{ return queued_tasks > 0 || unfinished_tasks == 0; });
+			--idle_workers;
+			continue;
+		}
+
+		Task& task = *get_task(id);
+		Polymer polymer;
+		polymer.init(system.left_initiator(), system.right_initiator());
+		simulate(polymer, task, out, w);
+		if (streaming)
+			flush_output(out);
+		else {
+			task.pieces.push_back(out.str());
+			task.children.push_back(-1);
+			out.clear();
+		}
+
+		lock_guard<mutex> guard(pool_lock);
+		if (--unfinished_tasks == 0)
+			pool_wakeup.notify_all();
+	}
+}
+
+// Prints the output of a task and the tasks it donated work to, in search
+// order, leaving out the kept polymers printed already.
+void Simulator :: print_task_output(int id) {
+	Task* task = tasks[id];
+	unsigned int k = 0; /* the next kept polymer */
+	size_t offset = 0; /* of its print ids */
+	for (unsigned int i = 0; i < task->pieces.size(); ++i) {
+		bool print = true;
+		if (k < task->polymer_pieces.size() && task->polymer_pieces[k] == i) {
+			print = unique_kept_polymer(*task, k++, offset);
+			if (print) {
+				COUNT(terminal_polymers);
+				++_polymers_found;
+			}
+			else
+				COUNT(duplicate_polymers);
+		}
+		if (print)
+			*output << task->pieces[i];
+		if (task->children[i] != -1)
+			print_task_output(task->children[i]);
+	}
+}
+
+// Runs the search on "threads" workers, a task per donated subtree.
+// A worker whose deque is empty while another worker is idle donates
+// the remaining candidates of its oldest unfinished choice point.
+template <class Polymer>
+void Simulator :: run_parallel() {
+	Task* root = new Task;
+	root->site_index = 0;
+	root->type = 0;
+	root->site_insertable = false;
+	root->resumed = false;
+	unfinished_tasks = 1;
+	workers = new Worker[threads];
+	workers[0].tasks.push_back(new_task(root));
+	queued_tasks = 1;
+
+	vector<thread> pool;
+	for (int w = 0; w < threads; ++w)
+		pool.push_back(thread(&Simulator::work<Polymer>, this, w));
+	for (int w = 0; w < threads; ++w)
+		pool[w].join();
+
+	if (!streaming) {
+		print_task_output(0);
+		MERGE_COUNTERS();
+	}
+	for (unsigned int i = 0; i < tasks.size(); ++i)
+		delete tasks[i];
+	tasks.clear();
+	delete[] workers;
+	workers = NULL;
+}
+
+// Deepest cut chosen for a sharded search, for searches that only grow deeper
+static const int MAX_SHARD_DEPTH = 1 << 24;
+
+// Returns whether a search sharded at depth "depth" has enough units for
+// the shards: at least 64 per shard, or all of the search tree if it is
+// no deeper than that. Found by a search that skips every unit.
+template <class Polymer>
+bool Simulator :: enough_units(int depth) {
+	int shard = index.shard;
+	index.shard = -1;
+	shard_depth = depth;
+	next_unit = 0;
+	polymer_units = 0;
+
+	Polymer polymer;
+	polymer.init(system.left_initiator(), system.right_initiator());
+	Task root;
+	root.site_index = 0;
+	root.type = 0;
+	root.site_insertable = false;
+	root.resumed = false;
+	Output out;
+	simulate(polymer, root, out, -1);
+
+	index.shard = shard;
+	return next_unit >= 64ULL * index.shards || next_unit == polymer_units;
+}
+
+template <class Polymer>
+bool Simulator :: enumerate(Output& out) {
+	output = &out;
+	if (index.shards > 1) {
+		// Without a depth, cut at the first depth with enough units, found
+		// by doubling the depth and then bisecting
+		if (index.depth == 0) {
+			int lo = 0, hi = 1; /* too few units at depth lo */
+			while (hi < MAX_SHARD_DEPTH && !enough_units<Polymer>(hi)) {
+				lo = hi;
+				hi *= 2;
+			}
+			while (hi - lo > 1) {
+				int mid = lo + (hi - lo) / 2;
+				if (enough_units<Polymer>(mid))
+					hi = mid;
+				else
+					lo = mid;
+			}
+			index.depth = hi;
+			total_counters = Counters();
+			_peak_pool_usage = 0;
+		}
+		shard_depth = index.depth;
+		next_unit = 0;
+		index.fingerprint = system.fingerprint();
+		index.unit_polymers.clear();
+	}
+
+	if (unique) {
+		// Types that differ only in their sign print the same
+		map<vector<unsigned int>, unsigned int> ids;
+		print_id.resize(system.size() + 2);
+		for (int t = 0; t < system.size() + 2; ++t) {
+			InsertionSystem::MonomerType m = system.type(t);
+			unsigned int half = (m.p == 'l' ? 1 : m.p == 'r' ? 2 : 0);
+			vector<unsigned int> key = {m.a, m.b, m.c, m.d, half};
+			print_id[t] = ids.insert(make_pair(key, (unsigned int) ids.size())).first->second;
+		}
+		delete unique_set;
+		delete unique_filter;
+		unique_set = (filter_bytes == 0 ? new PolymerSet() : NULL);
+		unique_filter = (filter_bytes > 0 ? new PolymerFilter(filter_bytes) : NULL);
+	}
+
+	if (threads > 1) {
+		run_parallel<Polymer>();
+		return true;
+	}
+
+	Polymer polymer;
+	polymer.init(system.left_initiator(), system.right_initiator());
+	Task root;
+	root.site_index = 0;
+	root.type = 0;
+	root.site_insertable = false;
+	root.resumed = false;
+	simulate(polymer, (resuming ? resumed : root), out, -1);
+	resuming = false;
+	if (index.shards > 1) {
+		index.units = next_unit;
+		index.polymers = _polymers_found;
+	}
+
+	// The search is finished, so there is nothing left to resume
+	if (!checkpoint_file.empty())
+		remove(checkpoint_file.c_str());
+	return true;
+}
+
+bool Simulator :: run(Output& out) {
+	if (threads > 1 && (verbose || !checkpoint_file.empty())) {
+		_error = "verbose output and checkpoints need a single thread";
+		return false;
+	}
+	if (index.shards > 1 && (threads > 1 || verbose || !checkpoint_file.empty() || resuming)) {
+		_error = "a sharded search needs a single thread, and no verbose output or checkpoints";
+		return false;
+	}
+	if (unique && (!checkpoint_file.empty() || resuming || index.shards > 1)) {
+		_error = "printing unique polymers needs no checkpoints and no sharding";
+		return false;
+	}
+	if (representation == "list")
+		return enumerate<ListPolymer>(out);
+	return enumerate<GapPolymer>(out);
+}
@@ -0,0 +1,189 @@
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "insertionsystem.h"
+#include "output.h"
+#include "polymerset.h"
+#include "shard.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::atomic;
+using std::condition_variable;
+using std::deque;
+using std::mutex;
+using std::pair;
+using std::string;
+using std::vector;
+
+// Enumeration of the terminal polymers of an insertion system by a
+// depth-first search over insertions, undoing each insertion once the
+// polymers extending it are found. Polymers (or just their sizes) are
+// printed in search order as they are found.
+//
+// All of the search state lives in the Simulator, so several simulators,
+// each with its own system, may run at once in one process. The system
+// must be indexed (build_index()) before the simulator is run.
+class Simulator {
+
+	public:
+		// Search counters, updated only if compiled with INSERTION_STATS
+		// ("make STATS=1"), and zero otherwise.
+		typedef struct {
+			unsigned long long candidate_calls, candidate_hits;
+			unsigned long long insertions, backtracks, terminal_polymers;
+			unsigned long long duplicate_polymers; /* not printed by --unique */
+			unsigned long long max_depth, peak_size;
+			vector<unsigned long long> type_hits; /* insertions of each monomer type */
+		} Counters;
+
+		Simulator(InsertionSystem& system);
+		~Simulator();
+
+		// Options, each off by default. Verbose output and checkpoints need
+		// a single thread.
+		void set_sizes_only(bool sizes_only); /* print "Polymer size: n" for each polymer */
+		void set_verbose(bool verbose); /* print each insertion as it is made */
+		void set_representation(const string& name); /* "gap" (default) or "list", see polymer.h */
+		void set_threads(int threads, bool streaming); /* streaming: print in the order found */
+		void set_checkpoint(const string& file, int interval); /* save the search every interval seconds */
+		// Enumerates only shard "shard" of "shards", cutting the search tree
+		// into units at insertion depth "depth", or at a depth giving enough
+		// units to balance the shards if "depth" is 0 (see shard.h). Needs a
+		// single thread, no checkpoints and no verbose output.
+		void set_shard(int shard, int shards, int depth);
+		// Prints each distinct terminal polymer once, where it is first
+		// found, remembering those printed in a PolymerSet, or in a
+		// PolymerFilter of "filter_bytes" bytes if that is not 0 (see
+		// polymerset.h). Needs no checkpoints and no sharding.
+		void set_unique(bool unique, size_t filter_bytes);
+
+		// Loads the search state saved in the checkpoint file, to be
+		// continued by run().
+		bool resume();
+
+		// Enumerates the terminal polymers, printing them to "out".
+		bool run(Output& out);
+
+		unsigned long long polymers_found(); /* including those found before resuming */
+		unsigned long long output_resumed(); /* bytes of output written before resuming */
+		unsigned long long peak_pool_usage(); /* most monomers held by one polymer's storage (see polymer.h) */
+		const Counters& counters();
+		const ShardIndex& shard_index(); /* which units' polymers run() printed, if sharded */
+		const string& error();
+
+	private:
+		template <class Polymer>
+		struct Insertion {
+			typename Polymer::Position monomer;
+			int index; /* position of the monomer in the polymer */
+			int type;
+			int left, right; /* types of the monomers of the site it was inserted into */
+			int donated; /* task given the remaining candidates of the site, or -1 */
+			unsigned long long hash; /* for --unique, rolling hash of the monomers up to the site */
+		};
+
+		// A subtree of the search: the polymer built by the insertions in "prefix",
+		// explored starting with candidate "type" of the site left of monomer
+		// "site_index". The search of a task never undoes the prefix insertions,
+		// unless they were restored from a checkpoint.
+		typedef struct {
+			vector<pair<int, int> > prefix; /* (index, type) of each insertion */
+			int site_index;
+			int type;
+			bool site_insertable;
+			bool resumed; /* restored from a checkpoint: "type" is exact and the prefix is undone as usual */
+			// Output in search order: pieces[i] is followed by the output of
+			// task children[i] (if not -1).
+			vector<string> pieces;
+			vector<int> children;
+			// With --unique and ordered output, the terminal polymers are
+			// checked for duplicates as they are printed: piece
+			// polymer_pieces[k] is polymer k, with rolling hash
+			// polymer_hashes[k] and, for an exact set, its length and print
+			// ids next in polymer_ids.
+			vector<unsigned int> polymer_pieces;
+			vector<unsigned long long> polymer_hashes;
+			vector<unsigned int> polymer_ids;
+		} Task;
+
+		// Work-stealing pool for multiple threads. Each worker keeps a deque
+		// of task ids: it takes its own work from the back and others steal
+		// from the front.
+		typedef struct {
+			mutex lock;
+			deque<int> tasks;
+		} Worker;
+
+		template <class Polymer> bool enumerate(Output& out);
+		template <class Polymer> void run_parallel();
+		template <class Polymer> void work(int w);
+		template <class Polymer> void simulate(Polymer& polymer, Task& task, Output& out, int w);
+		template <class Polymer> int candidate(Polymer& polymer, typename Polymer::Position site, int from);
+		template <class Polymer> void print_polymer(Output& out, Polymer& polymer);
+		template <class Polymer> typename Polymer::Position insert_monomer(Output& out, Polymer& polymer,
+			int type, typename Polymer::Position loc);
+		template <class Polymer> void donate(int w, vector<Insertion<Polymer> >& insertions, unsigned int& checked);
+		template <class Polymer> void save_checkpoint(vector<Insertion<Polymer> >& insertions,
+			unsigned long long found, int site_index, int type, bool site_insertable);
+		Task* get_task(int id);
+		int new_task(Task* task);
+		void flush_output(Output& out);
+		void print_task_output(int id);
+		template <class Polymer> bool enough_units(int depth);
+		bool shard_subtree();
+		bool shard_polymer(unsigned int depth);
+		template <class Polymer> bool unique_polymer(Polymer& polymer, unsigned long long hash);
+		template <class Polymer> void get_print_ids(Polymer& polymer, vector<unsigned int>& ids);
+		template <class Polymer> void keep_polymer(Task& task, Output& out, Polymer& polymer, unsigned long long hash);
+		bool unique_kept_polymer(Task& task, unsigned int k, size_t& offset);
+		void count_type(int t);
+		void merge_counters();
+
+		InsertionSystem& system;
+		bool sizes_only;
+		bool verbose;
+		string representation;
+		int threads;
+		bool streaming;
+		string checkpoint_file; /* file to save the search state to, or "" */
+		int checkpoint_interval; /* seconds between checkpoints */
+		bool resuming;
+		Task resumed; /* search state loaded by resume() */
+		int shard_depth; /* depth of the units of a sharded search, or 0 */
+		unsigned long long next_unit; /* units of a sharded search met so far */
+		unsigned long long polymer_units; /* those that are terminal polymers */
+		ShardIndex index;
+		bool unique;
+		size_t filter_bytes; /* size of the PolymerFilter, or 0 for an exact PolymerSet */
+		PolymerSet* unique_set;
+		PolymerFilter* unique_filter;
+		vector<unsigned int> print_id; /* of each monomer type: equal for types that print the same */
+
+		Output* output; /* where run() prints */
+		atomic<unsigned long long> _polymers_found;
+		unsigned long long _output_resumed;
+		unsigned long long _peak_pool_usage;
+		Counters total_counters;
+		mutex counters_lock;
+		string _error;
+
+		vector<Task*> tasks;
+		mutex tasks_lock;
+		Worker* workers;
+		atomic<int> idle_workers;
+		atomic<int> queued_tasks;
+		int unfinished_tasks;
+		mutex pool_lock;
+		condition_variable pool_wakeup;
+		mutex output_lock;
+};
+
+#endif
+
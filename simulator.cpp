@@ -2,214 +2,557 @@
 #include <cstdio>
 #include <iostream>
 #include <list>
+#include <map>
 #include <vector>
-#include <stack>
-#include <climits>
-
-using std::cin;
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "bigint.h"
+#include "insertionsystem.h"
+#include "output.h"
+#include "parser.h"
+#include "sampler.h"
+#include "simulation.h"
+#include "sitegraph.h"
+#include "stats.h"
+#include "slp.h"
+
+using std::atomic;
+using std::condition_variable;
 using std::cout;
 using std::cerr;
 using std::endl;
 using std::list;
+using std::lock_guard;
+using std::make_pair;
+using std::map;
+using std::max;
+using std::mutex;
+using std::pair;
 using std::string;
-using std::stack;
+using std::thread;
+using std::unique_lock;
 using std::vector;
 
-typedef struct {
-	int a, b, c, d;
-	char p;
-} MonomerType;
-
-typedef struct Monomer Monomer;
-
-struct Monomer {
-	MonomerType type;
-	Monomer* prev;
-	Monomer* next;
-};
-
-typedef struct {
-	Monomer* monomer;
-	int type;
-} Insertion;
-
-static vector<MonomerType> monomer_types;
-static Monomer* polymer;
-static int polymer_size;
-static stack<Insertion> insertions; 
+static InsertionSystem insertion_system;
 static bool sflag = false; /* size flag (just print polymer sizes) */
 static bool vflag = false; /* verbose flag (print each insertion) */
+static string pflag = "gap"; /* polymer representation flag */
+static int jflag = 1; /* number of worker threads */
+static bool streamflag = false; /* print polymers as found rather than in search order */
+static bool aflag = false; /* asynchronous output flag (write output from a background thread) */
+static bool cflag = false; /* count flag (count terminal polymers without building them) */
+static bool lflag = false; /* length flag (measure a deterministic system's polymer without building it) */
+static bool gflag = false; /* grammar flag (write a deterministic system's polymer as a straight-line program) */
+static bool analyzeflag = false; /* analyze flag (report growth, nondeterminism and maximum size without enumerating) */
+static string checkpoint_file; /* file to save the search state to, or "" */
+static int checkpoint_interval = 10; /* seconds between checkpoints */
+static bool resumeflag = false; /* resume flag (continue the search saved in checkpoint_file) */
+static unsigned long long samples = 0; /* sample flag (number of random terminal polymers to build), or 0 */
+static unsigned long long seed = 1; /* seed for sampling */
+static unsigned long long max_insertions = 10000000; /* insertions after which a sample is abandoned */
+static bool kflag = false; /* kinetic flag (sample with per-type rates and report completion times) */
+static bool statsflag = false; /* stats flag (print phase times and search counters as JSON) */
+static int shard = 0, shards = 1; /* shard flag (enumerate only shard i of N, see shard.h) */
+static int shard_depth = 0; /* insertion depth at which the search is cut into units, or 0 to choose one */
+static string shard_index_file; /* file to write the shard's index to */
+static bool uniqueflag = false; /* unique flag (print each distinct terminal polymer once) */
+static unsigned long long bloom_mb = 0; /* megabytes of the Bloom filter for approximate --unique, or 0 for exact */
+
+
+// Polymer sizes (as numbers of inserted monomers) and how many terminal
+// polymers have each size, sorted by size.
+typedef vector<pair<unsigned long long, BigInt> > Histogram;
+
+// The ways of filling a site until no insertions remain.
+typedef struct {
+	BigInt polymers;
+	BigInt min, max; /* fewest and most monomers inserted */
+	Histogram sizes;
+} SiteCount;
+
+// Adds the histogram of sizes x + y + 1, for x from h1 and y from h2, to "sum".
+void add_combined_sizes(map<unsigned long long, BigInt>& sum, const Histogram& h1, const Histogram& h2) {
+	for (unsigned int i = 0; i < h1.size(); ++i)
+		for (unsigned int j = 0; j < h2.size(); ++j)
+			sum[h1[i].first + h2[j].first + 1] += h1[i].second * h2[j].second;
+}
 
-void print_monomer(MonomerType monomer, bool sign);
+// Which sites can be finished (filled until no insertions remain): those
+// accepting no insertions, or a finishing insertion, one whose two sites
+// can be finished. Found by propagating finished sites to the insertions
+// into sites they come from, as for the productive non-terminals of a
+// grammar.
+typedef struct {
+	vector<int> edge_start; /* insertion i of site s is edge edge_start[s] + i */
+	vector<char> finishing; /* of each edge */
+	vector<char> finished; /* of each site */
+} Finishable;
+
+Finishable find_finishable(SiteGraph& graph) {
+	Finishable f;
+	f.edge_start.assign(graph.size() + 1, 0);
+	for (int s = 0; s < graph.size(); ++s)
+		f.edge_start[s+1] = f.edge_start[s] + graph.insertions(s);
+	int insertions = f.edge_start[graph.size()];
+
+	vector<int> uses_start(graph.size() + 1, 0); /* uses of site s: uses[uses_start[s] .. uses_start[s+1]-1] */
+	vector<pair<int, int> > uses(2 * insertions); /* (site, insertion) */
+	for (int s = 0; s < graph.size(); ++s)
+		for (int i = 0; i < graph.insertions(s); ++i) {
+			++uses_start[graph.insertion(s, i).left + 1];
+			++uses_start[graph.insertion(s, i).right + 1];
+		}
+	for (int s = 0; s < graph.size(); ++s)
+		uses_start[s+1] += uses_start[s];
+	vector<int> placed(uses_start.begin(), uses_start.end() - 1);
+	for (int s = 0; s < graph.size(); ++s)
+		for (int i = 0; i < graph.insertions(s); ++i) {
+			uses[placed[graph.insertion(s, i).left]++] = make_pair(s, i);
+			uses[placed[graph.insertion(s, i).right]++] = make_pair(s, i);
+		}
 
-void insert_monomer(MonomerType t, Monomer* loc) {
-	if(vflag) {
-		cout << "Inserting ";
-		print_monomer(t, true);
-		cout << " into site ";
-		print_monomer(loc->type, false);
-		print_monomer(loc->next->type, false);
-		cout << endl;
+	vector<char> unfinished(insertions, 2); /* sites of each insertion not yet finished */
+	f.finished.assign(graph.size(), 0);
+	vector<int> worklist;
+	for (int s = 0; s < graph.size(); ++s)
+		if (graph.insertions(s) == 0) {
+			f.finished[s] = 1;
+			worklist.push_back(s);
+		}
+	for (unsigned int k = 0; k < worklist.size(); ++k) {
+		int s = worklist[k];
+		for (int u = uses_start[s]; u < uses_start[s+1]; ++u) {
+			int parent = uses[u].first;
+			if (--unfinished[f.edge_start[parent] + uses[u].second] == 0 && !f.finished[parent]) {
+				f.finished[parent] = 1;
+				worklist.push_back(parent);
+			}
+		}
 	}
 
-	Monomer* new_monomer = (Monomer*) malloc(sizeof(Monomer));
+	f.finishing.assign(insertions, 0);
+	for (int e = 0; e < insertions; ++e)
+		f.finishing[e] = (unfinished[e] == 0);
+	return f;
+}
 
-	new_monomer->next = loc->next;
-	loc->next->prev = new_monomer;
-	loc->next = new_monomer;
-	new_monomer->prev = loc;
-	new_monomer->type = t;
+// Lists the sites reachable from the root by finishing insertions in
+// "order", each after the sites it splits into. Returns false if these
+// insertions reach a cycle, so that terminal polymers are unbounded in
+// size (and number).
+bool finishing_order(SiteGraph& graph, const Finishable& f, vector<int>& order) {
+	vector<char> state(graph.size(), 0); /* 0 = unvisited, 1 = on stack, 2 = done */
+	vector<pair<int, int> > stack; /* (site, next child to visit) */
+	order.clear();
+	state[graph.root()] = 1;
+	stack.push_back(make_pair(graph.root(), 0));
+	while (!stack.empty()) {
+		int s = stack.back().first;
+		int i = stack.back().second;
+		if (i == 2 * graph.insertions(s)) {
+			state[s] = 2;
+			order.push_back(s);
+			stack.pop_back();
+			continue;
+		}
 
-	++polymer_size;
+		++stack.back().second;
+		if (!f.finishing[f.edge_start[s] + i / 2])
+			continue;
+		const SiteGraph::Insertion& e = graph.insertion(s, i / 2);
+		int child = (i % 2 == 0 ? e.left : e.right);
+		if (state[child] == 1)
+			return false;
+		if (state[child] == 0) {
+			state[child] = 1;
+			stack.push_back(make_pair(child, 0));
+		}
+	}
+	return true;
 }
 
-void remove_monomer(Monomer* mon) {
-	Monomer* prev = mon->prev;
-	Monomer* next = mon->next;
-	prev->next = next;
-	next->prev = prev;
+// Counts the terminal polymers, and their sizes, without building them.
+// The ways of filling a site depend only on its signature, and are the
+// sum over its finishing insertions of the products of the ways of
+// filling the two sites each insertion creates. So each signature is
+// counted once, children first.
+int count_polymers() {
+	SiteGraph graph(insertion_system);
+	Finishable f = find_finishable(graph);
+
+	// Like simulate(), report nothing for an initiator that accepts no insertions
+	int root = graph.root();
+	if (graph.insertions(root) == 0 || !f.finished[root]) {
+		cout << "Terminal polymers: 0" << endl;
+		return EXIT_SUCCESS;
+	}
+	vector<int> order;
+	if (!finishing_order(graph, f, order)) {
+		cerr << "Error: the system has terminal polymers of unbounded size.\n";
+		return EXIT_FAILURE;
+	}
 
-	free(mon);
+	vector<SiteCount> counts(graph.size());
+	for (unsigned int k = 0; k < order.size(); ++k) {
+		int s = order[k];
+		SiteCount& count = counts[s];
+		if (graph.insertions(s) == 0) {
+			count.polymers = BigInt(1);
+			count.min = count.max = BigInt(0);
+			count.sizes.push_back(make_pair(0ULL, BigInt(1)));
+			continue;
+		}
 
-	--polymer_size;
-}
+		map<unsigned long long, BigInt> sizes;
+		bool first = true;
+		for (int i = 0; i < graph.insertions(s); ++i) {
+			if (!f.finishing[f.edge_start[s] + i])
+				continue;
+			const SiteCount& left = counts[graph.insertion(s, i).left];
+			const SiteCount& right = counts[graph.insertion(s, i).right];
+			count.polymers += left.polymers * right.polymers;
+			BigInt min = left.min + right.min + BigInt(1);
+			BigInt max = left.max + right.max + BigInt(1);
+			if (first || min < count.min)
+				count.min = min;
+			if (first || count.max < max)
+				count.max = max;
+			first = false;
+			if (sflag) {
+				// Sizes are added as 64-bit integers, so check that they fit first
+				if (!max.fits_u64()) {
+					cerr << "Error: polymer sizes are too large for a size histogram.\n";
+					return EXIT_FAILURE;
+				}
+				add_combined_sizes(sizes, left.sizes, right.sizes);
+			}
+		}
+		count.sizes.assign(sizes.begin(), sizes.end());
+	}
 
-bool monomers_equal(MonomerType m1, MonomerType m2) {
-	return (m1.a == m2.a && m1.b == m2.b && m1.c == m2.c && m1.d == m2.d && m1.p == m2.p);
-}
+	const SiteCount& count = counts[root];
+	cout << "Terminal polymers: " << count.polymers.str() << endl;
+	cout << "Minimum polymer size: " << (count.min + BigInt(2)).str() << endl;
+	cout << "Maximum polymer size: " << (count.max + BigInt(2)).str() << endl;
+	for (unsigned int i = 0; i < count.sizes.size(); ++i)
+		cout << "Polymer size " << count.sizes[i].first + 2 << ": " << count.sizes[i].second.str() << endl;
 
-int abs(int n) {
-	return n < 0 ? -n : n;
+	return EXIT_SUCCESS;
 }
 
-int desanitize(int n) {
-	if (n == INT_MAX || n == -INT_MAX)
-		return 0;
-	return abs(n);
-}
 
-int sanitize(int n, bool c) {
-	if (n != 0)
-		return c ? -n : n;
-	return (c ? -INT_MAX : INT_MAX);
+// Checks that the system is deterministic and has a terminal polymer.
+bool check_deterministic(SiteGraph& graph) {
+	for (int s = 0; s < graph.size(); ++s) {
+		if (graph.insertions(s) > 1) {
+			cerr << "Error: the system is not deterministic.\n";
+			return false;
+		}
+	}
+	if (!graph.is_acyclic()) {
+		cerr << "Error: the system has no terminal polymer.\n";
+		return false;
+	}
+	return true;
 }
 
-void print_monomer_rh(MonomerType monomer) {
-	cout << "(" << desanitize(monomer.c) << (monomer.c < 0 ? "*, " : ", ") << desanitize(monomer.d) << (monomer.d < 0 ? "*" : "") << ")"; 
-}
+// Computes the size of the terminal polymer of a deterministic system, and
+// the number of rounds needed to build it if every insertable site is
+// filled at once, without building it. In a deterministic system each site
+// accepts at most one monomer type, so a site's signature determines the
+// subpolymer that fills it.
+int measure_polymer() {
+	SiteGraph graph(insertion_system);
+	if (!check_deterministic(graph))
+		return EXIT_FAILURE;
+
+	vector<BigInt> length(graph.size()); /* monomers inserted into each site */
+	vector<int> depth(graph.size(), 0); /* rounds of insertions to fill each site */
+	const vector<int>& order = graph.order();
+	for (unsigned int k = 0; k < order.size(); ++k) {
+		int s = order[k];
+		if (graph.insertions(s) == 0)
+			continue;
+		const SiteGraph::Insertion& e = graph.insertion(s, 0);
+		length[s] = length[e.left] + length[e.right] + BigInt(1);
+		depth[s] = 1 + max(depth[e.left], depth[e.right]);
+	}
 
-void print_monomer_lh(MonomerType monomer) {
-	cout << "(" << desanitize(monomer.a) << (monomer.a < 0 ? "*, " : ", ") << desanitize(monomer.b) << (monomer.b < 0 ? "*" : "") << ")"; 
+	// Like simulate(), report nothing for an initiator that accepts no insertions
+	if (graph.insertions(graph.root()) == 0) {
+		cout << "Terminal polymers: 0" << endl;
+		return EXIT_SUCCESS;
+	}
+	cout << "Polymer size: " << (length[graph.root()] + BigInt(2)).str() << endl;
+	cout << "Parallel insertion depth: " << depth[graph.root()] << endl;
+
+	return EXIT_SUCCESS;
 }
 
-void print_monomer(MonomerType monomer, bool sign) {
-	// Naming: left hand init monomer has only right two symbols printed, 
-	// so the "print..rh" function is called. Similar for left.
-	if(monomer.p == 'l')
-		return print_monomer_rh(monomer); 
-	if(monomer.p == 'r')                      
-		return print_monomer_lh(monomer); 
-
-	cout << "(" << desanitize(monomer.a) << (monomer.a < 0 ? "*" : "") << ", " 
-		<< desanitize(monomer.b) << (monomer.b < 0 ? "*" : "") << ", "
-		<< desanitize(monomer.c) << (monomer.c < 0 ? "*" : "") << ", "
-		<< desanitize(monomer.d) << (monomer.d < 0 ? "*" : "") << ")"
-		<< (sign ? (monomer.p == '+' ? "+" : "-") : "");
+
+// Writes the terminal polymer of a deterministic system as a straight-line
+// program (see slp.h) with one rule per site signature, without building it.
+int write_program() {
+	SiteGraph graph(insertion_system);
+	if (!check_deterministic(graph))
+		return EXIT_FAILURE;
+
+	// Like simulate(), print nothing for an initiator that accepts no insertions
+	if (graph.insertions(graph.root()) == 0)
+		return EXIT_SUCCESS;
+
+	StraightLineProgram program;
+	vector<int> monomers(insertion_system.size() + 2, -1); /* type -> program monomer */
+	int count = 0;
+	int halves[2] = {insertion_system.left_initiator(), insertion_system.right_initiator()};
+	for (int i = 0; i < 2; ++i) {
+		Output text;
+		insertion_system.print_monomer(text, insertion_system.type(halves[i]), false);
+		program.add_monomer(text.str());
+		monomers[halves[i]] = count++;
+	}
+
+	vector<int> rules(graph.size(), -1); /* site -> program rule */
+	const vector<int>& order = graph.order();
+	for (unsigned int k = 0; k < order.size(); ++k) {
+		int s = order[k];
+		if (graph.insertions(s) == 0) {
+			rules[s] = program.add_rule(-1, -1, -1);
+			continue;
+		}
+		const SiteGraph::Insertion& e = graph.insertion(s, 0);
+		if (monomers[e.type] == -1) {
+			Output text;
+			insertion_system.print_monomer(text, insertion_system.type(e.type), false);
+			program.add_monomer(text.str());
+			monomers[e.type] = count++;
+		}
+		rules[s] = program.add_rule(monomers[e.type], rules[e.left], rules[e.right]);
+	}
+	program.set_root(rules[graph.root()]);
+
+	cout << "# Straight-line program for a terminal polymer, written by simulator -g\n";
+	program.write(cout);
+
+	return EXIT_SUCCESS;
 }
 
-// Tests whether a monomer type "inserted" is insertable into a site
-// specified by the left monomer "loc" of the site. 
-bool insertable(MonomerType inserted, Monomer* loc) {
-	MonomerType left_mon = loc->type;
-	MonomerType right_mon = loc->next->type;
-
-	// For definitions of these rules, see Definitions section of http://arxiv.org/abs/1401.0359
-	if (inserted.p == '+')
-		return (left_mon.d == -inserted.a) && (-inserted.d == right_mon.a) 
-			&& (left_mon.c == -right_mon.b) && (left_mon.d != -right_mon.a); 
-	if (inserted.p == '-')
-		return (left_mon.c == -inserted.b) && (-inserted.c == right_mon.b) 
-			&& (left_mon.d == -right_mon.a) && (left_mon.c != -right_mon.b);
-	return false;
+
+// Prints a site signature as the two halves "(c, d) (a, b)" around it.
+void print_site(Output& out, const SiteGraph::Site& site) {
+	out << "(";
+	insertion_system.print_symbol(out, site.c);
+	out << ", ";
+	insertion_system.print_symbol(out, site.d);
+	out << ") (";
+	insertion_system.print_symbol(out, site.a);
+	out << ", ";
+	insertion_system.print_symbol(out, site.b);
+	out << ")";
 }
 
-void print_polymer() {
-	if(sflag) {
-		cout << "Polymer size: " << polymer_size << endl; 
-		return;
-	}
-
-	Monomer* cur = polymer;
-	while (cur != NULL) {
-		if (cur->prev == NULL)
-			print_monomer_rh(cur->type);
-		else if (cur->next == NULL)
-			print_monomer_lh(cur->type);
-		else
-			print_monomer(cur->type, false);
-		cout << ' ';
-		cur = cur->next;
-	}
-
-	cout << endl;
-}		
-
-void simulate() {
-	Insertion insert;
-	Monomer* site = polymer;
-	int type = 0;
-	bool site_insertable = false;
-
-	while (insertions.size() != 0 || type < monomer_types.size()) {	
-		// if you've reached the end
-		if (site->next == NULL) {
-			if(vflag)
-				cout << "Terminal polymer:" << endl;
-			// print the polymer and pop the stack
-			print_polymer();
-			if(vflag)
-				cout << "------------------------------\n";
-			site = insertions.top().monomer->prev;
-			type = insertions.top().type+1;
-			remove_monomer(insertions.top().monomer);
-			insertions.pop();
-			site_insertable = true;
-			continue;
+// Analyzes the system's site graph without enumerating polymers: whether
+// the search can grow forever (a cycle of sites), which sites accept more
+// than one monomer type (nondeterminism), and the largest terminal polymer.
+// Each step is linear in the size of the graph.
+int analyze_system() {
+	// Sites listed in full, of those accepting several types
+	static const int LISTED_SITES = 10;
+
+	SiteGraph graph(insertion_system);
+	Output out(stdout, false);
+
+	vector<char> fires(insertion_system.size(), 0);
+	int insertions = 0, nondeterministic = 0;
+	for (int s = 0; s < graph.size(); ++s) {
+		insertions += graph.insertions(s);
+		for (int i = 0; i < graph.insertions(s); ++i)
+			fires[graph.insertion(s, i).type] = 1;
+		if (graph.insertions(s) > 1)
+			++nondeterministic;
+	}
+	out << "Reachable sites: " << graph.size() << "\n";
+	int fired = 0;
+	for (int t = 0; t < insertion_system.size(); ++t)
+		fired += fires[t];
+	out << "Monomer types that fire: " << fired << " of " << insertion_system.size() << "\n";
+
+	out << "Grows forever: " << (graph.is_acyclic() ? "no" : "yes") << "\n";
+	if (!graph.is_acyclic()) {
+		const vector<int>& cycle = graph.cycle();
+		out << "Cycle: ";
+		for (unsigned int i = 0; i <= cycle.size(); ++i) {
+			if (i > 0)
+				out << " -> ";
+			print_site(out, graph.site(cycle[i % cycle.size()]));
 		}
-		
-		// roll over to next site
-		if (type == monomer_types.size()) {
-			if (site_insertable) {
-				// pop the stack
-				site = insertions.top().monomer->prev;
-				type = insertions.top().type+1;
-				remove_monomer(insertions.top().monomer);
-				insertions.pop();					
-				site_insertable = true;
-			}
-			else {
-				// continue on to the next site
-				type = 0;
-				site = site->next;	
-				site_insertable = false;
-			}
+		out << "\n";
+	}
+
+	out << "Nondeterministic sites: " << nondeterministic << "\n";
+	int listed = 0;
+	for (int s = 0; s < graph.size() && listed < LISTED_SITES; ++s) {
+		if (graph.insertions(s) <= 1)
 			continue;
+		out << "  ";
+		print_site(out, graph.site(s));
+		out << " accepts " << graph.insertions(s) << " monomer types\n";
+		++listed;
+	}
+	if (nondeterministic > listed)
+		out << "  ...\n";
+	out << "Deterministic: " << (nondeterministic == 0 ? "yes" : "no") << "\n";
+
+	Finishable f = find_finishable(graph);
+
+	// Like simulate(), report nothing for an initiator that accepts no insertions
+	int root = graph.root();
+	if (graph.insertions(root) == 0 || !f.finished[root]) {
+		out << "Terminal polymers: no\n";
+		out.flush();
+		return EXIT_SUCCESS;
+	}
+	out << "Terminal polymers: yes\n";
+
+	// The largest terminal polymer fills each site with its largest
+	// finishing insertion, children first
+	vector<int> order;
+	bool bounded = finishing_order(graph, f, order);
+	vector<BigInt> most(graph.size()); /* monomers inserted into each site */
+	for (unsigned int k = 0; bounded && k < order.size(); ++k) {
+		int s = order[k];
+		for (int i = 0; i < graph.insertions(s); ++i) {
+			const SiteGraph::Insertion& e = graph.insertion(s, i);
+			if (f.finishing[f.edge_start[s] + i] && most[s] < most[e.left] + most[e.right] + BigInt(1))
+				most[s] = most[e.left] + most[e.right] + BigInt(1);
 		}
+	}
+	if (bounded)
+		out << "Maximum polymer size: " << (most[root] + BigInt(2)).str() << "\n";
+	else
+		out << "Maximum polymer size: unbounded\n";
+	out.flush();
+
+	return EXIT_SUCCESS;
+}
 
-		// the usual case: try to insert the monomer,
-		// if insertion isn't possible, go to the next monomer
-		if (insertable(monomer_types[type], site)) {
-			insert_monomer(monomer_types[type], site);
-			insert.monomer = site->next;
-			insert.type = type;
-			insertions.push(insert);
 
-			type = 0;
-			site_insertable = false;
+// Samples "samples" terminal polymers with Sampler, using jflag threads
+// that take samples one at a time and merge their statistics into 
+// "sample_total" now and then.
+static Sampler::Stats sample_total;
+static mutex sample_lock;
+static condition_variable sample_done;
+static atomic<unsigned long long> next_sample(0);
+static int sampling_threads;
+
+void sample_worker(Sampler* sampler) {
+	// Merge after every 256 samples or 2^20 insertions, whichever comes first
+	Sampler::Stats stats;
+	unsigned long long work = 0;
+	while (true) {
+		unsigned long long i = next_sample++;
+		if (i < samples)
+			work += sampler->sample(i, stats);
+		if (i >= samples || stats.samples + stats.unfinished == 256 || work >= (1 << 20)) {
+			lock_guard<mutex> guard(sample_lock);
+			sample_total.merge(stats);
+			stats = Sampler::Stats();
+			work = 0;
 		}
-		else
-			++type;	
+		if (i >= samples)
+			break;
 	}
+
+	lock_guard<mutex> guard(sample_lock);
+	if (--sampling_threads == 0)
+		sample_done.notify_all();
+}
+
+int sample_polymers() {
+	SiteGraph graph(insertion_system);
+
+	// Like simulate(), report nothing for an initiator that accepts no insertions
+	if (graph.insertions(graph.root()) == 0) {
+		cout << "Terminal polymers: 0" << endl;
+		return EXIT_SUCCESS;
+	}
+
+	Sampler sampler(graph, insertion_system, seed, max_insertions, kflag);
+	sampling_threads = jflag;
+	vector<thread> threads;
+	for (int w = 0; w < jflag; ++w)
+		threads.push_back(thread(sample_worker, &sampler));
+
+	// Report progress every few seconds until the workers finish
+	{
+		unique_lock<mutex> guard(sample_lock);
+		while (!sample_done.wait_for(guard, std::chrono::seconds(5), []{ return sampling_threads == 0; })) {
+			fprintf(stderr, "Sampled %llu of %llu: mean polymer size %.6g, variance %.6g",
+				sample_total.samples + sample_total.unfinished, samples, sample_total.mean, sample_total.variance());
+			if (kflag)
+				fprintf(stderr, ", mean completion time %.6g", sample_total.time_mean);
+			fprintf(stderr, "\n");
+		}
+	}
+	for (int w = 0; w < jflag; ++w)
+		threads[w].join();
+
+	const Sampler::Stats& stats = sample_total;
+	printf("Samples: %llu\n", stats.samples);
+	if (stats.unfinished > 0)
+		printf("Unfinished samples (over %llu insertions): %llu\n", max_insertions, stats.unfinished);
+	printf("Mean polymer size: %.6f\n", stats.mean);
+	printf("Polymer size variance: %.6f\n", stats.variance());
+	printf("Mean insertions: %.6f\n", stats.samples > 0 ? stats.mean - 2 : 0.0);
+	if (kflag) {
+		printf("Mean completion time: %.6f\n", stats.time_mean);
+		printf("Completion time variance: %.6f\n", stats.time_variance());
+		printf("Minimum completion time: %.6f\n", stats.time_min);
+		printf("Maximum completion time: %.6f\n", stats.time_max);
+	}
+	for (map<unsigned long long, unsigned long long>::const_iterator it = stats.sizes.begin(); it != stats.sizes.end(); ++it)
+		printf("Polymer size %llu: %llu\n", it->first, it->second);
+
+	return EXIT_SUCCESS;
+}
+
+
+// Prints the phase times, the peak monomer storage of an enumeration
+// and (if compiled in) search counters for --stats.
+void print_stats(PhaseTimer& timer, unsigned long long peak_pool, const Simulator::Counters& t) {
+	Output fields;
+	fields << "  \"peak_pool_monomers\": " << peak_pool << ",\n";
+#ifdef INSERTION_STATS
+	fields << "  \"counters\": {\n"
+		<< "    \"candidate_calls\": " << t.candidate_calls << ",\n"
+		<< "    \"candidate_hits\": " << t.candidate_hits << ",\n"
+		<< "    \"insertions\": " << t.insertions << ",\n"
+		<< "    \"backtracks\": " << t.backtracks << ",\n"
+		<< "    \"terminal_polymers\": " << t.terminal_polymers << ",\n"
+		<< "    \"duplicate_polymers\": " << t.duplicate_polymers << ",\n"
+		<< "    \"max_depth\": " << t.max_depth << ",\n"
+		<< "    \"peak_polymer_size\": " << t.peak_size << ",\n"
+		<< "    \"type_hits\": [";
+	bool first = true;
+	for (unsigned int i = 0; i < t.type_hits.size(); ++i) {
+		if (t.type_hits[i] == 0)
+			continue;
+		fields << (first ? "\n" : ",\n") << "      {\"type\": \"";
+		insertion_system.print_monomer(fields, insertion_system.type(i), true);
+		fields << "\", \"hits\": " << t.type_hits[i] << "}";
+		first = false;
+	}
+	fields << "\n    ]\n  }";
+#else
+	fields << "  \"counters\": null";
+#endif
+	timer.write_json(stderr, "simulator", fields.str());
 }
 
 
@@ -227,153 +570,236 @@ int main(int argc, char *argv[]) {
 			sflag = true;
 		else if (arg == "-v")
 			vflag = true;
+		else if (arg == "-p" && i+1 < argc && (string(argv[i+1]) == "gap" || string(argv[i+1]) == "list"))
+			pflag = argv[++i];
+		else if (arg == "-j" && i+1 < argc && atoi(argv[i+1]) > 0)
+			jflag = atoi(argv[++i]);
+		else if (arg == "--streaming")
+			streamflag = true;
+		else if (arg == "--async-output")
+			aflag = true;
+		else if (arg == "--checkpoint" && i+1 < argc)
+			checkpoint_file = argv[++i];
+		else if (arg == "--checkpoint-interval" && i+1 < argc && atoi(argv[i+1]) > 0)
+			checkpoint_interval = atoi(argv[++i]);
+		else if (arg == "--resume")
+			resumeflag = true;
+		else if (arg == "--sample" && i+1 < argc && strtoull(argv[i+1], NULL, 10) > 0)
+			samples = strtoull(argv[++i], NULL, 10);
+		else if (arg == "--seed" && i+1 < argc)
+			seed = strtoull(argv[++i], NULL, 10);
+		else if (arg == "--max-insertions" && i+1 < argc && strtoull(argv[i+1], NULL, 10) > 0)
+			max_insertions = strtoull(argv[++i], NULL, 10);
+		else if (arg == "--kinetic")
+			kflag = true;
+		else if (arg == "--shard" && i+1 < argc && sscanf(argv[i+1], "%d/%d", &shard, &shards) == 2 
+			&& shards > 0 && shard >= 0 && shard < shards)
+			++i;
+		else if (arg == "--shard-depth" && i+1 < argc && atoi(argv[i+1]) > 0)
+			shard_depth = atoi(argv[++i]);
+		else if (arg == "--shard-index" && i+1 < argc)
+			shard_index_file = argv[++i];
+		else if (arg == "--unique")
+			uniqueflag = true;
+		else if (arg == "--unique-bloom" && i+1 < argc && strtoull(argv[i+1], NULL, 10) > 0) {
+			uniqueflag = true;
+			bloom_mb = strtoull(argv[++i], NULL, 10);
+		}
+		else if (arg == "--stats")
+			statsflag = true;
+		else if (arg == "-c")
+			cflag = true;
+		else if (arg == "-l")
+			lflag = true;
+		else if (arg == "-g")
+			gflag = true;
+		else if (arg == "-a")
+			analyzeflag = true;
 		else if (arg == "--help" || arg == "-help" || arg == "-h") {
 			cout << "Command line arguments:" << endl;
 			cout << "    -v             output entire step-by-step insertion process" << endl;
 			cout << "    -s             output only sizes of terminal polymers      " << endl;
+			cout << "    -p gap|list    polymer representation (default: gap)       " << endl;
+			cout << "    -j N           enumerate with N threads                    " << endl;
+			cout << "    --streaming    with -j, print polymers as they are found   " << endl;
+			cout << "                   instead of in sequential order              " << endl;
+			cout << "    --async-output write output from a background thread while  " << endl;
+			cout << "                   the simulation continues                    " << endl;
+			cout << "    --checkpoint F save the search state to file F periodically," << endl;
+			cout << "                   and remove it when the search is finished   " << endl;
+			cout << "    --checkpoint-interval N                                     " << endl;
+			cout << "                   save the search state every N seconds       " << endl;
+			cout << "                   (default: 10)                               " << endl;
+			cout << "    --resume       continue the search saved by --checkpoint   " << endl;
+			cout << "    -c             count terminal polymers and their sizes     " << endl;
+			cout << "                   without building them (with -s, also print  " << endl;
+			cout << "                   the number of polymers of each size)        " << endl;
+			cout << "    -l             for a deterministic system, output the size " << endl;
+			cout << "                   of its terminal polymer and the number of   " << endl;
+			cout << "                   rounds of parallel insertion that build it, " << endl;
+			cout << "                   without building it                         " << endl;
+			cout << "    -g             for a deterministic system, output its      " << endl;
+			cout << "                   terminal polymer as a straight-line program " << endl;
+			cout << "                   with one rule per site (see slpquery)       " << endl;
+			cout << "    -a             analyze the system without enumerating it:  " << endl;
+			cout << "                   whether it can grow forever (with a cycle   " << endl;
+			cout << "                   of sites), which sites accept more than one " << endl;
+			cout << "                   monomer type, and its largest terminal      " << endl;
+			cout << "                   polymer size                                " << endl;
+			cout << "    --sample N     build N terminal polymers by inserting      " << endl;
+			cout << "                   monomers at random, and output statistics   " << endl;
+			cout << "                   of their sizes (on the threads of -j)       " << endl;
+			cout << "    --seed S       random seed for --sample (default: 1)       " << endl;
+			cout << "    --max-insertions N                                          " << endl;
+			cout << "                   abandon samples after N insertions          " << endl;
+			cout << "                   (default: 10000000)                         " << endl;
+			cout << "    --kinetic      with --sample, let each insertable monomer  " << endl;
+			cout << "                   type insert after an exponentially          " << endl;
+			cout << "                   distributed time with its rate (the number  " << endl;
+			cout << "                   after its sign, default: 1), and output     " << endl;
+			cout << "                   statistics of completion times              " << endl;
+			cout << "    --shard i/N    enumerate only shard i (from 0) of N, a     " << endl;
+			cout << "                   slice of the search tree that N processes   " << endl;
+			cout << "                   can enumerate independently; shardmerge    " << endl;
+			cout << "                   merges their outputs into search order      " << endl;
+			cout << "    --shard-index F                                             " << endl;
+			cout << "                   with --shard, write the shard's index to F  " << endl;
+			cout << "                   for shardmerge (required)                   " << endl;
+			cout << "    --shard-depth D                                             " << endl;
+			cout << "                   with --shard, slice the search tree at the  " << endl;
+			cout << "                   D-th insertion (default: chosen so that     " << endl;
+			cout << "                   each shard gets at least 64 slices)         " << endl;
+			cout << "    --unique       print each distinct terminal polymer once,  " << endl;
+			cout << "                   where it is first in search order (with     " << endl;
+			cout << "                   --streaming, where it is first found)       " << endl;
+			cout << "    --unique-bloom M                                            " << endl;
+			cout << "                   like --unique, but in M megabytes of memory " << endl;
+			cout << "                   at most, and so approximate: as the filter  " << endl;
+			cout << "                   fills up, some distinct polymers are taken  " << endl;
+			cout << "                   for duplicates and not printed              " << endl;
+			cout << "    --stats        print the time spent in each phase, and     " << endl;
+			cout << "                   search counters if built with STATS=1, to   " << endl;
+			cout << "                   stderr as JSON                              " << endl;
 			cout << "    -h, -help      print program information                   " << endl;
 			cout << "        --help                                                 " << endl;
 		}
 	}	
 
 	// Parse piped input
-	polymer_size = 0;
-	MonomerType m;
-	int n;
-	bool c;
-	while (cin) {
-		cin >> std::ws;
-		if (cin.peek() == '#') {
-			cin.ignore(1000, '\n');
-			continue;
-		}
-		if (cin.peek() == EOF)
-			break;
-	
-		if (cin.peek() != '(' || !(cin.ignore())) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected '('.\n";
-			return EXIT_FAILURE;
-		}
-		cin >> std::ws;
-		if (!(cin >> n)) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected an integer.\n";
-			return EXIT_FAILURE;
-		}
-		cin >> std::ws;
-		c = (cin.peek() == '*');
-		if (cin.peek() == '*') {
-			cin.ignore();
-			cin >> std::ws;
-		}
-		m.a = sanitize(n, c);
+	PhaseTimer timer;
+	timer.start("parse");
+	Parser parser;
+	if (!parser.open(0) || !insertion_system.read(parser)) {
+		cerr << "Error: " << parser.error() << ".\n";
+		return EXIT_FAILURE;
+	}
 
-		if (cin.peek() != ',' || !(cin.ignore())) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected '*' or ','.\n";
-			return EXIT_FAILURE;	
-		}
-		cin >> std::ws;
-		if (!(cin >> n)) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected an integer.\n";
-			return EXIT_FAILURE;
-		}
-		cin >> std::ws;
-		c = (cin.peek() == '*');
-		if (cin.peek() == '*') {
-			cin.ignore();
-			cin >> std::ws;
-		}
-		m.b = sanitize(n, c);
-
-		if (cin.peek() == ')') {
-			cin.ignore();
-			if (polymer_size == 0) {
-				polymer = (Monomer*) malloc(sizeof(Monomer));
-				polymer->prev = polymer->next = NULL;
-				++polymer_size;
-				m.c = m.a;
-				m.d = m.b;
-				m.a = m.b = 0;
-				m.p = 'l'; /* left initiator monomer */
-				polymer->type = m;
-			}
-			else if (polymer_size == 1) {
-				polymer->next = (Monomer*) malloc(sizeof(Monomer));
-				polymer->next->prev = polymer;
-				polymer->next->next = NULL;
-				++polymer_size;
-				m.c = m.d = 0;
-				m.p = 'r'; /* right initiator monomer */
-				polymer->next->type = m;
-
-				// Check that initiator has matching symbols
-				if (polymer->type.c != -polymer->next->type.b && polymer->type.d != -polymer->next->type.a) {
-					cerr << "Error: initiator has no bond." << endl;	
-					return EXIT_FAILURE;
-				}
-			}
-			else if (polymer_size == 2) {
-				cerr << "Error: more than two initiator halves specified.\n";
-				return EXIT_FAILURE;
-			}
-			continue;
-		}
-		if (cin.peek() != ',' || !(cin.ignore())) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected '*', ',', or ')'.\n";
-			return EXIT_FAILURE;
-		}
-		cin >> std::ws;
+	if (vflag && jflag > 1) {
+		cerr << "Error: -v cannot be combined with -j.\n";
+		return EXIT_FAILURE;
+	}
 
-		if (!(cin >> n)) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected an integer.\n";
-			return EXIT_FAILURE;
-		}
-		cin >> std::ws;
-		c = (cin.peek() == '*');
-		if (cin.peek() == '*') {
-			cin.ignore();
-			cin >> std::ws;
-		}
-		m.c = sanitize(n, c);
+	if (!checkpoint_file.empty() && jflag > 1) {
+		cerr << "Error: --checkpoint cannot be combined with -j.\n";
+		return EXIT_FAILURE;
+	}
 
-		if (cin.peek() != ',' || !(cin.ignore())) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected '*' or ','.\n";
-			return EXIT_FAILURE;
-		}
-		cin >> std::ws;
-		if (!(cin >> n)) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected an integer.\n";
-			return EXIT_FAILURE;
-		}
-		cin >> std::ws;
-		c = (cin.peek() == '*');
-		if (cin.peek() == '*') {
-			cin.ignore();
-			cin >> std::ws;
+	if (resumeflag && checkpoint_file.empty()) {
+		cerr << "Error: --resume requires --checkpoint.\n";
+		return EXIT_FAILURE;
+	}
+
+	if (kflag && samples == 0) {
+		cerr << "Error: --kinetic requires --sample.\n";
+		return EXIT_FAILURE;
+	}
+
+	if (shards > 1 && (vflag || jflag > 1 || !checkpoint_file.empty())) {
+		cerr << "Error: --shard cannot be combined with -v, -j or --checkpoint.\n";
+		return EXIT_FAILURE;
+	}
+
+	// -a, -c, -l, -g and --sample don't enumerate the polymers one by one
+	bool enumerating = !(analyzeflag || cflag || lflag || gflag || samples > 0);
+
+	if (shards > 1 && !enumerating) {
+		cerr << "Error: --shard cannot be combined with -a, -c, -l, -g or --sample.\n";
+		return EXIT_FAILURE;
+	}
+
+	if (uniqueflag && (shards > 1 || !checkpoint_file.empty())) {
+		cerr << "Error: --unique cannot be combined with --shard or --checkpoint.\n";
+		return EXIT_FAILURE;
+	}
+
+	if (uniqueflag && !enumerating) {
+		cerr << "Error: --unique cannot be combined with -a, -c, -l, -g or --sample.\n";
+		return EXIT_FAILURE;
+	}
+
+	if (shards > 1 && shard_index_file.empty()) {
+		cerr << "Error: --shard requires --shard-index.\n";
+		return EXIT_FAILURE;
+	}
+
+	timer.start("index");
+	insertion_system.build_index();
+
+	timer.start("simulate");
+	int result = EXIT_SUCCESS;
+	Simulator::Counters counters = Simulator::Counters();
+	unsigned long long peak_pool = 0; /* monomers held by the polymer storage at most */
+	if (analyzeflag)
+		result = analyze_system();
+	else if (cflag)
+		result = count_polymers();
+	else if (lflag)
+		result = measure_polymer();
+	else if (gflag)
+		result = write_program();
+	else if (samples > 0)
+		result = sample_polymers();
+	else {
+		Simulator simulator(insertion_system);
+		simulator.set_sizes_only(sflag);
+		simulator.set_verbose(vflag);
+		simulator.set_representation(pflag);
+		simulator.set_threads(jflag, streamflag);
+		simulator.set_checkpoint(checkpoint_file, checkpoint_interval);
+		simulator.set_shard(shard, shards, shard_depth);
+		simulator.set_unique(uniqueflag, bloom_mb << 20);
+		if (resumeflag) {
+			if (!simulator.resume()) {
+				cerr << "Error: " << simulator.error() << ".\n";
+				return EXIT_FAILURE;
+			}
+			cerr << "Resuming after " << simulator.polymers_found() << " terminal polymers and " 
+				<< simulator.output_resumed() << " bytes of output.\n";
 		}
-		m.d = sanitize(n, c);
 
-		if (cin.peek() != ')' || !(cin.ignore())) {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected '*' or ')'.\n";
+		Output out(stdout, aflag);
+		if (!simulator.run(out)) {
+			cerr << "Error: " << simulator.error() << ".\n";
 			return EXIT_FAILURE;
 		}
-		cin >> std::ws;
-		if (cin.peek() != '+' && cin.peek() != '-') {
-			cerr << "Error: unexpected token '" << char(cin.peek()) << "', expected '+' or '-'.\n";
+		counters = simulator.counters();
+		peak_pool = simulator.peak_pool_usage();
+		timer.start("output");
+		out.flush();
+
+		ShardIndex index = simulator.shard_index();
+		if (shards > 1 && !index.write(shard_index_file)) {
+			cerr << "Error: " << index.error() << ".\n";
 			return EXIT_FAILURE;
 		}
-		cin >> m.p;
-
-		bool repeat = false;
-		for (int i = 0; i < monomer_types.size(); ++i)
-			if (monomers_equal(m, monomer_types[i]))
-				repeat = true;
-		if (!repeat)
-			monomer_types.push_back(m);
 	}
+	fflush(stdout);
+	cout.flush();
+	timer.stop();
 
-	simulate();
-
-	return EXIT_SUCCESS;
+	if (statsflag)
+		print_stats(timer, peak_pool, counters);
+	return result;
 }
 
 
@@ -0,0 +1,133 @@
+
+#include "sitegraph.h"
+#include <utility>
+
+using std::make_pair;
+using std::pair;
+
+size_t SiteGraph::SiteHash :: operator()(const Site& s) const {
+	size_t h = s.c;
+	h = h * 1000003 ^ s.d;
+	h = h * 1000003 ^ s.a;
+	h = h * 1000003 ^ s.b;
+	return h;
+}
+
+bool SiteGraph::SiteEqual :: operator()(const Site& s1, const Site& s2) const {
+	return (s1.c == s2.c && s1.d == s2.d && s1.a == s2.a && s1.b == s2.b);
+}
+
+// Builds the graph by a breadth-first search from the site of the initiator.
+// Sites are numbered in the order they are found, starting with the initiator's.
+SiteGraph :: SiteGraph(InsertionSystem& system) {
+	InsertionSystem::MonomerType l = system.type(system.left_initiator());
+	InsertionSystem::MonomerType r = system.type(system.right_initiator());
+	Site initiator = {l.c, l.d, r.a, r.b};
+	add_site(initiator);
+
+	for (unsigned int s = 0; s < sites.size(); ++s) {
+		edge_start.push_back(edges.size());
+		Site cur = sites[s];
+		int t = system.candidate(cur.c, cur.d, cur.a, cur.b, 0);
+		while (t != -1) {
+			InsertionSystem::MonomerType m = system.type(t);
+			Site left = {cur.c, cur.d, m.a, m.b};
+			Site right = {m.c, m.d, cur.a, cur.b};
+			Insertion e;
+			e.type = t;
+			e.left = add_site(left);
+			e.right = add_site(right);
+			edges.push_back(e);
+			t = system.candidate(cur.c, cur.d, cur.a, cur.b, t+1);
+		}
+	}
+	edge_start.push_back(edges.size());
+
+	sort();
+}
+
+int SiteGraph :: add_site(Site s) {
+	unordered_map<Site, int, SiteHash, SiteEqual>::iterator it = site_ids.find(s);
+	if (it != site_ids.end())
+		return it->second;
+	site_ids[s] = sites.size();
+	sites.push_back(s);
+	return sites.size() - 1;
+}
+
+int SiteGraph :: size() {
+	return sites.size();
+}
+
+int SiteGraph :: root() {
+	return 0;
+}
+
+SiteGraph::Site SiteGraph :: site(int s) {
+	return sites[s];
+}
+
+int SiteGraph :: insertions(int s) {
+	return edge_start[s+1] - edge_start[s];
+}
+
+const SiteGraph::Insertion& SiteGraph :: insertion(int s, int i) {
+	return edges[edge_start[s] + i];
+}
+
+// Whether no site can (eventually) be split into a site with its own
+// signature, i.e. whether the system's polymers have bounded length.
+bool SiteGraph :: is_acyclic() {
+	return acyclic;
+}
+
+const vector<int>& SiteGraph :: cycle() {
+	return _cycle;
+}
+
+// Returns the sites ordered so that every site comes after the sites it
+// can be split into (meaningful only if the graph is acyclic).
+const vector<int>& SiteGraph :: order() {
+	return _order;
+}
+
+// Computes a post-order of the sites with an iterative depth-first
+// search, noting any site found on the search stack as a cycle.
+void SiteGraph :: sort() {
+	vector<char> state(sites.size(), 0); /* 0 = unvisited, 1 = on stack, 2 = done */
+	vector<pair<int, int> > stack; /* (site, next child to visit) */
+	acyclic = true;
+
+	state[root()] = 1;
+	stack.push_back(make_pair(root(), 0));
+	while (!stack.empty()) {
+		int s = stack.back().first;
+		int i = stack.back().second;
+		if (i == 2 * insertions(s)) {
+			state[s] = 2;
+			_order.push_back(s);
+			stack.pop_back();
+			continue;
+		}
+
+		++stack.back().second;
+		const Insertion& e = insertion(s, i / 2);
+		int child = (i % 2 == 0 ? e.left : e.right);
+		if (state[child] == 1) {
+			// The stack from child up is a cycle
+			if (acyclic) {
+				int k = stack.size() - 1;
+				while (stack[k].first != child)
+					--k;
+				for (; k < (int) stack.size(); ++k)
+					_cycle.push_back(stack[k].first);
+			}
+			acyclic = false;
+		}
+		else if (state[child] == 0) {
+			state[child] = 1;
+			stack.push_back(make_pair(child, 0));
+		}
+	}
+}
+
@@ -0,0 +1,65 @@
+
+#ifndef SITEGRAPH_H
+#define SITEGRAPH_H
+
+#include "insertionsystem.h"
+#include <unordered_map>
+#include <vector>
+
+using std::unordered_map;
+using std::vector;
+
+// Graph of the site signatures reachable from the initiator of an
+// insertion system. Which monomer types a site accepts depends only on
+// its signature: the symbols (c, d) of its left monomer and (a, b) of
+// its right monomer. Inserting a monomer splits a site into two.
+class SiteGraph {
+
+	public:
+		typedef InsertionSystem::Symbol Symbol;
+
+		typedef struct {
+			Symbol c, d, a, b;
+		} Site;
+
+		// Inserting monomer type "type" splits a site into sites "left" and "right".
+		typedef struct {
+			int type;
+			int left, right;
+		} Insertion;
+
+		SiteGraph(InsertionSystem& system);
+		int size();
+		int root();
+		Site site(int s);
+		int insertions(int s);
+		const Insertion& insertion(int s, int i);
+		bool is_acyclic();
+		// Sites s1, s2, ..., sk where each can be split into a site with the
+		// signature of the next, and sk into s1 (empty if acyclic).
+		const vector<int>& cycle();
+		const vector<int>& order();
+
+	private:
+		struct SiteHash {
+			size_t operator()(const Site& s) const;
+		};
+		struct SiteEqual {
+			bool operator()(const Site& s1, const Site& s2) const;
+		};
+
+		int add_site(Site s);
+		void sort();
+
+		vector<Site> sites;
+		unordered_map<Site, int, SiteHash, SiteEqual> site_ids;
+		// insertions of site s are edges[edge_start[s] .. edge_start[s+1]-1]
+		vector<int> edge_start;
+		vector<Insertion> edges;
+		bool acyclic;
+		vector<int> _cycle; /* the first cycle found */
+		vector<int> _order; /* sites after the sites they split into */
+};
+
+#endif
+
@@ -0,0 +1,206 @@
+
+#include "slp.h"
+#include <sstream>
+#include <utility>
+
+using std::getline;
+using std::istringstream;
+using std::make_pair;
+using std::pair;
+
+StraightLineProgram :: StraightLineProgram() {
+	root = -1;
+}
+
+void StraightLineProgram :: add_monomer(const string& text) {
+	monomers.push_back(text);
+}
+
+// Adds a rule for monomer "monomer" between the expansions of rules "left"
+// and "right", or an empty rule if "monomer" is -1. Returns the rule's index.
+int StraightLineProgram :: add_rule(int monomer, int left, int right) {
+	Rule r = {monomer, left, right};
+	rules.push_back(r);
+	return rules.size() - 1;
+}
+
+void StraightLineProgram :: set_root(int rule) {
+	root = rule;
+	compute_sizes();
+}
+
+// Reads the next line that isn't blank or a comment.
+static bool next_line(istream& in, string& line, int& line_number) {
+	while (getline(in, line)) {
+		++line_number;
+		size_t i = line.find_first_not_of(" \t\r");
+		if (i != string::npos && line[i] != '#')
+			return true;
+	}
+	return false;
+}
+
+static string at_line(int line_number) {
+	std::ostringstream s;
+	s << "line " << line_number << ": ";
+	return s.str();
+}
+
+bool StraightLineProgram :: read(istream& in, string& error) {
+	string line, word;
+	int line_number = 0;
+	int count;
+
+	if (!next_line(in, line, line_number) || !(istringstream(line) >> word >> count) || word != "monomers" || count < 2) {
+		error = at_line(line_number) + "expected \"monomers M\" with M >= 2";
+		return false;
+	}
+	for (int i = 0; i < count; ++i) {
+		if (!next_line(in, line, line_number)) {
+			error = at_line(line_number) + "expected a monomer";
+			return false;
+		}
+		add_monomer(line);
+	}
+
+	if (!next_line(in, line, line_number) || !(istringstream(line) >> word >> count) || word != "rules" || count < 1) {
+		error = at_line(line_number) + "expected \"rules R\" with R >= 1";
+		return false;
+	}
+	for (int i = 0; i < count; ++i) {
+		if (!next_line(in, line, line_number)) {
+			error = at_line(line_number) + "expected a rule";
+			return false;
+		}
+		istringstream s(line);
+		int m, l, r;
+		if ((s >> word) && word == "-")
+			add_rule(-1, -1, -1);
+		else if ((istringstream(line) >> m >> l >> r)
+			&& m >= 0 && m < (int) monomers.size() && l >= 0 && l < i && r >= 0 && r < i)
+			add_rule(m, l, r);
+		else {
+			error = at_line(line_number) + "expected \"-\" or a monomer and two earlier rules";
+			return false;
+		}
+	}
+
+	if (!next_line(in, line, line_number) || !(istringstream(line) >> word >> root) || word != "root"
+		|| root < 0 || root >= (int) rules.size()) {
+		error = at_line(line_number) + "expected \"root k\" for a rule k";
+		return false;
+	}
+
+	if (!compute_sizes()) {
+		error = "the polymer has more than 2^64 monomers";
+		return false;
+	}
+	return true;
+}
+
+void StraightLineProgram :: write(ostream& out) {
+	out << "monomers " << monomers.size() << '\n';
+	for (unsigned int i = 0; i < monomers.size(); ++i)
+		out << monomers[i] << '\n';
+	out << "rules " << rules.size() << '\n';
+	for (unsigned int i = 0; i < rules.size(); ++i) {
+		if (rules[i].monomer == -1)
+			out << "-\n";
+		else
+			out << rules[i].monomer << ' ' << rules[i].left << ' ' << rules[i].right << '\n';
+	}
+	out << "root " << root << '\n';
+}
+
+// Computes expansion sizes and depths; rules only refer to earlier rules.
+// Returns false if a size overflows.
+bool StraightLineProgram :: compute_sizes() {
+	sizes.assign(rules.size(), 0);
+	depths.assign(rules.size(), 0);
+	for (unsigned int i = 0; i < rules.size(); ++i) {
+		Rule& r = rules[i];
+		if (r.monomer == -1)
+			continue;
+		unsigned long long size = sizes[r.left] + sizes[r.right] + 1;
+		if (size <= sizes[r.left] || size <= sizes[r.right])
+			return false;
+		sizes[i] = size;
+		depths[i] = 1 + (depths[r.left] > depths[r.right] ? depths[r.left] : depths[r.right]);
+	}
+	return sizes[root] <= ~0ULL - 2;
+}
+
+unsigned long long StraightLineProgram :: size() {
+	return sizes[root] + 2;
+}
+
+int StraightLineProgram :: depth() {
+	return depths[root];
+}
+
+const string& StraightLineProgram :: monomer(int m) {
+	return monomers[m];
+}
+
+// Returns the monomer at position i by descending from the root, 
+// in time proportional to the depth of the program.
+int StraightLineProgram :: monomer_at(unsigned long long i) {
+	if (i == 0)
+		return 0;
+	if (i == size() - 1)
+		return 1;
+
+	--i;
+	int cur = root;
+	while (true) {
+		Rule& r = rules[cur];
+		if (i < sizes[r.left])
+			cur = r.left;
+		else if (i == sizes[r.left])
+			return r.monomer;
+		else {
+			i -= sizes[r.left] + 1;
+			cur = r.right;
+		}
+	}
+}
+
+// Appends the monomers at positions from, from+1, ..., to-1 to "monomers",
+// in time proportional to the depth of the program plus to - from.
+void StraightLineProgram :: slice(unsigned long long from, unsigned long long to, vector<int>& monomers) {
+	if (to > size())
+		to = size();
+	if (from >= to)
+		return;
+	if (from == 0)
+		monomers.push_back(0);
+
+	// Visit the part of each expansion that overlaps [from, to), 
+	// where "offset" is the position of the expansion's first monomer
+	bool last = (to == size());
+	vector<pair<int, unsigned long long> > stack; /* (rule, offset), or (-1 - monomer, 0) */
+	stack.push_back(make_pair(root, 1ULL));
+	while (!stack.empty()) {
+		int cur = stack.back().first;
+		unsigned long long offset = stack.back().second;
+		stack.pop_back();
+		if (cur < 0) {
+			monomers.push_back(-1 - cur);
+			continue;
+		}
+		Rule& r = rules[cur];
+		if (r.monomer == -1 || offset >= to || offset + sizes[cur] <= from)
+			continue;
+
+		unsigned long long middle = offset + sizes[r.left];
+		// Right part first, so the left part is popped first
+		stack.push_back(make_pair(r.right, middle + 1));
+		if (from <= middle && middle < to)
+			stack.push_back(make_pair(-1 - r.monomer, 0ULL));
+		stack.push_back(make_pair(r.left, offset));
+	}
+
+	if (last)
+		monomers.push_back(1);
+}
+
@@ -0,0 +1,63 @@
+
+#ifndef SLP_H
+#define SLP_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using std::istream;
+using std::ostream;
+using std::string;
+using std::vector;
+
+// Straight-line program for the terminal polymer of a deterministic
+// insertion system, as written by simulator -g. Rule k is either empty or
+// a monomer between the expansions of two earlier rules, so the program
+// has one rule per site signature however long the polymer is. The
+// polymer is the left initiator half, the expansion of the root rule, and
+// the right initiator half.
+//
+// The text format is:
+//   monomers M
+//   <M lines, one monomer each, the initiator halves first>
+//   rules R
+//   <R lines, "-" for an empty rule or "m l r" for monomer m between rules l and r>
+//   root k
+// with '#' comment lines allowed anywhere.
+class StraightLineProgram {
+
+	public:
+		typedef struct {
+			int monomer; /* -1 for an empty rule */
+			int left, right;
+		} Rule;
+
+		StraightLineProgram();
+		bool read(istream& in, string& error);
+		void write(ostream& out);
+
+		void add_monomer(const string& text);
+		int add_rule(int monomer, int left, int right);
+		void set_root(int rule);
+
+		// Queries, valid after read() or set_root(). Positions start at 0.
+		unsigned long long size();
+		int depth();
+		int monomer_at(unsigned long long i);
+		void slice(unsigned long long from, unsigned long long to, vector<int>& monomers);
+		const string& monomer(int m);
+
+	private:
+		bool compute_sizes();
+
+		vector<string> monomers;
+		vector<Rule> rules;
+		int root;
+		vector<unsigned long long> sizes; /* monomers in each rule's expansion */
+		vector<int> depths;
+};
+
+#endif
+
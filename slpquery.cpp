@@ -0,0 +1,69 @@
+/*
+Program for querying a terminal polymer stored as a straight-line program,
+as output by simulator -g, without expanding it.
+
+The program takes a straight-line program from stdin. With no arguments
+it prints the polymer's size and the depth of the program. With one
+argument i it prints the monomer at position i, and with two arguments
+i j it prints the monomers at positions i, i+1, ..., j-1. Positions
+start at 0. Each query takes time proportional to the depth of the
+program (plus j - i for a slice).
+*/
+
+#include "slp.h"
+#include <cstdlib>
+#include <iostream>
+
+using std::cerr;
+using std::cin;
+using std::cout;
+using std::endl;
+
+// Parses a position, returning false if "s" isn't a non-negative integer.
+bool parse_position(const char* s, unsigned long long& i) {
+	char* end;
+	if (*s < '0' || *s > '9')
+		return false;
+	i = strtoull(s, &end, 10);
+	return *end == '\0';
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long long from = 0, to = 0;
+	if (argc > 3 || (argc > 1 && !parse_position(argv[1], from)) || (argc > 2 && !parse_position(argv[2], to))) {
+		cerr << "Usage: slpquery [i [j]] < program" << endl;
+		return EXIT_FAILURE;
+	}
+
+	StraightLineProgram program;
+	string error;
+	if (!program.read(cin, error)) {
+		cerr << "Error: " << error << endl;
+		return EXIT_FAILURE;
+	}
+
+	if (argc == 1) {
+		cout << "Polymer size: " << program.size() << endl;
+		cout << "Program depth: " << program.depth() << endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (from >= program.size() || (argc == 3 && to > program.size())) {
+		cerr << "Error: position out of range, the polymer has size " << program.size() << endl;
+		return EXIT_FAILURE;
+	}
+
+	if (argc == 2) {
+		cout << program.monomer(program.monomer_at(from)) << endl;
+		return EXIT_SUCCESS;
+	}
+
+	vector<int> monomers;
+	program.slice(from, to, monomers);
+	for (unsigned int i = 0; i < monomers.size(); ++i)
+		cout << program.monomer(monomers[i]) << ' ';
+	cout << endl;
+
+	return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,41 @@
+
+#include "stats.h"
+#include <sys/resource.h>
+
+PhaseTimer :: PhaseTimer() {
+	running = false;
+}
+
+void PhaseTimer :: start(const char* name) {
+	stop();
+	Phase p = {name, 0, 0};
+	phases.push_back(p);
+	running = true;
+	wall_start = std::chrono::steady_clock::now();
+	cpu_start = clock();
+}
+
+void PhaseTimer :: stop() {
+	if (!running)
+		return;
+	Phase& p = phases.back();
+	p.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+	p.cpu = (double) (clock() - cpu_start) / CLOCKS_PER_SEC;
+	running = false;
+}
+
+void PhaseTimer :: write_json(FILE* f, const char* tool, const string& fields) {
+	stop();
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	fprintf(f, "{\n  \"tool\": \"%s\",\n  \"phases\": [", tool);
+	for (unsigned int i = 0; i < phases.size(); ++i)
+		fprintf(f, "%s\n    {\"name\": \"%s\", \"wall_seconds\": %.6f, \"cpu_seconds\": %.6f}",
+			(i > 0 ? "," : ""), phases[i].name, phases[i].wall, phases[i].cpu);
+	fprintf(f, "\n  ],\n  \"peak_rss_kb\": %ld", usage.ru_maxrss);
+	if (!fields.empty())
+		fprintf(f, ",\n%s", fields.c_str());
+	fprintf(f, "\n}\n");
+}
+
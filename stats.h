@@ -0,0 +1,42 @@
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Wall clock and CPU time spent in each phase of a run (parse, validate,
+// convert, simulate, output, ...), reported as JSON by --stats together
+// with the peak resident set size and any tool-specific counters.
+class PhaseTimer {
+
+	public:
+		PhaseTimer();
+		// Ends the current phase, if any, and starts phase "name".
+		void start(const char* name);
+		void stop();
+
+		// Writes {"tool": ..., "phases": [...], "peak_rss_kb": ..., <fields>}
+		// where "fields" is either empty or a list of JSON members.
+		void write_json(FILE* f, const char* tool, const string& fields);
+
+	private:
+		typedef struct {
+			const char* name;
+			double wall, cpu; /* seconds */
+		} Phase;
+
+		vector<Phase> phases;
+		bool running;
+		std::chrono::steady_clock::time_point wall_start;
+		clock_t cpu_start;
+};
+
+#endif
+
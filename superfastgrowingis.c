@@ -8,6 +8,7 @@ described in the proof of Theorem 4.2 of http://arxiv.org/abs/1401.0359
 The program takes a positive integer r as a command-line argument,
 and prints the resulting insertion system to stdout. 
 This output can be piped directly into simulator.
+With -b (after r) the system is written in the binary format of binary.h.
 
 The system deterministically constructs a polymer 
 of length 2^{Theta(r^3)}. Some example values for r:
@@ -18,9 +19,90 @@ r = 2, length = 3154033
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 int r;
 
+// Output (-b): the system is written in the binary format of binary.h,
+// the header when the initiator is output and a record per monomer type
+// as it is generated, with the record count left unknown. Otherwise the
+// system is printed as text.
+bool binary = false;
+int lo, hi; /* smallest and largest symbol, for the binary header */
+
+// Little-endian fields of the binary format
+void put_le(unsigned char* p, unsigned long long v, int bytes) {
+	for (int i = 0; i < bytes; ++i)
+		p[i] = (unsigned char) (v >> (8 * i));
+}
+
+// Prints a comment or blank line (text output only).
+void comment(const char* text) {
+	if (!binary)
+		fputs(text, stdout);
+}
+
+void print_symbol(int s, bool star) {
+	printf("%d%s", s, star ? "*" : "");
+}
+
+// Outputs the initiator (c, d) (a, b), with the symbols whose star is
+// true complemented.
+void initiator(int c, bool c_star, int d, bool d_star, int a, bool a_star, int b, bool b_star) {
+	if (!binary) {
+		printf("(");
+		print_symbol(c, c_star);
+		printf(", ");
+		print_symbol(d, d_star);
+		printf(") (");
+		print_symbol(a, a_star);
+		printf(", ");
+		print_symbol(b, b_star);
+		printf(")\n");
+		return;
+	}
+
+	unsigned char header[64] = {'I', 'N', 'S', 'B', 's', 1};
+	int symbols[4] = {c, d, a, b};
+	put_le(header + 6, 32, 2);
+	put_le(header + 8, ~0ULL, 8);
+	put_le(header + 16, (unsigned int) lo, 4);
+	put_le(header + 20, (unsigned int) hi, 4);
+	for (int i = 0; i < 4; ++i)
+		put_le(header + 24 + 4 * i, (unsigned int) symbols[i], 4);
+	put_le(header + 40, 1 | (c_star << 1) | (d_star << 2) | (a_star << 3) | (b_star << 4), 4);
+	fwrite(header, 1, sizeof(header), stdout);
+}
+
+// Outputs the monomer type (a, b, c, d) with sign '+' or '-', with the
+// symbols whose star is true complemented.
+void type(int a, bool a_star, int b, bool b_star, int c, bool c_star, int d, bool d_star, char sign) {
+	if (!binary) {
+		printf("(");
+		print_symbol(a, a_star);
+		printf(", ");
+		print_symbol(b, b_star);
+		printf(", ");
+		print_symbol(c, c_star);
+		printf(", ");
+		print_symbol(d, d_star);
+		printf(")%c\n", sign);
+		return;
+	}
+
+	unsigned char record[32] = {0};
+	int symbols[4] = {a, b, c, d};
+	double rate = 1;
+	unsigned long long rate_bits;
+	memcpy(&rate_bits, &rate, sizeof(rate_bits));
+	for (int k = 0; k < 4; ++k)
+		put_le(record + 4 * k, (unsigned int) symbols[k], 4);
+	record[16] = a_star | (b_star << 1) | (c_star << 2) | (d_star << 3);
+	record[17] = sign;
+	put_le(record + 24, rate_bits, 8);
+	fwrite(record, 1, sizeof(record), stdout);
+}
+
 int f(int i, int n) {
 	return n + 2 * i * r * r; 
 }
@@ -33,6 +115,7 @@ int main(int argc, char* argv[]) {
 	}
 
 	r = atoi(argv[1]);
+	binary = (argc > 2 && strcmp(argv[2], "-b") == 0);
 	if (r < 1) {
 		fprintf(stderr, "Provided r=%d is not positive.\n", r);
 		return EXIT_FAILURE;
@@ -40,119 +123,126 @@ int main(int argc, char* argv[]) {
 
         // x is a symbol not found anywhere else 
 	int x = f(16, 0);
+	lo = 0;
+	hi = x; /* the largest, as f(i, n) < x for the other symbols */
 
-        fprintf(stdout, "# Insertion ystem generated by superfastgrowingis using algorithm from\n");
-        fprintf(stdout, "# B. Hescott, C. Malchik, A. Winslow,\n");
-	fprintf(stdout, "# \"Tight bounds for active self-assembly using an insertion primitive\",\n");
-        fprintf(stdout, "# http://arxiv.org/abs/1401.0359\n\n");
+        comment("# Insertion ystem generated by superfastgrowingis using algorithm from\n");
+        comment("# B. Hescott, C. Malchik, A. Winslow,\n");
+	comment("# \"Tight bounds for active self-assembly using an insertion primitive\",\n");
+        comment("# http://arxiv.org/abs/1401.0359\n\n");
 
-	printf("# Initiator\n");
-	printf("(0, 0) (0, 0*)\n\n");	
+	comment("# Initiator\n");
+	initiator(0, false, 0, false, 0, false, 0, true);
+	comment("\n");
 
 
-        printf("# -------- Inner monomer types ------\n\n");
+        comment("# -------- Inner monomer types ------\n\n");
 
-	printf("# Inner - Step 1\n");
+	comment("# Inner - Step 1\n");
 	for (int b = 0; b < r; ++b)
 		for (int c = 0; c <= r; ++c)
-                        printf("(%d*, %d, %d, %d*)+\n", b, f(10, c), f(10, b+1), c);
-	printf("\n");
+                        type(b, true, f(10, c), false, f(10, b+1), false, c, true, '+');
+	comment("\n");
 
-	printf("# Inner - Step 2\n");
+	comment("# Inner - Step 2\n");
 	for (int a = 0; a <= r; ++a) 
 		for (int c = 0; c <= r; ++c) 
-			printf("(%d, %d*, %d*, %d)-\n", f(11, c), a, f(10, c), x);
+			type(f(11, c), false, a, true, f(10, c), true, x, false, '-');
 	for (int a = 0; a <= r; ++a) 
 		for (int b = 0; b < r; ++b) 
-			printf("(%d, %d*, %d, %d)-\n", x, f(10, b+1), a, b+1);
-	printf("\n");
+			type(x, false, f(10, b+1), true, a, false, b+1, false, '-');
+	comment("\n");
 
-	printf("# Inner - Step 3\n");
+	comment("# Inner - Step 3\n");
 	for (int b = 0; b < r; ++b) 
 		for (int c = 0; c <= r; ++c) 
-                        printf("(%d*, %d, %d, %d*)+\n", b, x, f(13, b), f(11, c));
+                        type(b, true, x, false, f(13, b), false, f(11, c), true, '+');
 	for (int a = 0; a <= r; ++a) 
 		for (int b = 0; b < r; ++b) 
-			printf("(%d, %d*, %d, %d)-\n", x, f(13, b), a, f(12, b));
-	printf("\n");
+			type(x, false, f(13, b), true, a, false, f(12, b), false, '-');
+	comment("\n");
 
-	printf("# Inner - Step 4\n");
+	comment("# Inner - Step 4\n");
 	for (int b = 0; b < r; ++b)
 		for (int c = 0; c <= r; ++c) 
-				printf("(%d*, %d, %d, %d*)+\n", f(12, b), f(14, c), x, f(11, c));
+				type(f(12, b), true, f(14, c), false, x, false, f(11, c), true, '+');
 	for (int a = 0; a <= r; ++a) 
 		for (int c = 0; c <= r; ++c) 
-			printf("(%d, %d*, %d*, %d)-\n", c, a, f(14, c), x);
-	printf("\n");
+			type(c, false, a, true, f(14, c), true, x, false, '-');
+	comment("\n");
 
-	printf("# Inner - Step 5\n");
+	comment("# Inner - Step 5\n");
 	for (int b = 0; b < r; ++b) 
 		for (int c = 0; c <= r; ++c) 
-				printf("(%d*, %d, %d, %d*)+\n", f(12, b), x, f(15, b+1), c);
+				type(f(12, b), true, x, false, f(15, b+1), false, c, true, '+');
 	for (int a = 0; a <= r; ++a) 
 		for (int b = 0; b < r; ++b) 
-			printf("(%d, %d*, %d, %d)-\n", x, f(15, b+1), a, b+1);
-	printf("\n");
+			type(x, false, f(15, b+1), true, a, false, b+1, false, '-');
+	comment("\n");
 
-	printf("\n");
+	comment("\n");
         
-        printf("# -------- Middle monomer types -----\n\n");
+        comment("# -------- Middle monomer types -----\n\n");
 
-	printf("# Middle - Step 1\n");
+	comment("# Middle - Step 1\n");
 	for (int c = 0; c < r; ++c) 
-		printf("(%d*, %d, %d, %d*)+\n", r, f(2, c), x, c);
+		type(r, true, f(2, c), false, x, false, c, true, '+');
 	for (int a = 0; a <= r; ++a) 
 		for (int c = 0; c < r; ++c) 
-			printf("(%d, %d*, %d*, %d)-\n", f(1, c), a, f(2, c), x);
-	printf("\n");
+			type(f(1, c), false, a, true, f(2, c), true, x, false, '-');
+	comment("\n");
 
-	printf("# Middle - Step 2\n");
+	comment("# Middle - Step 2\n");
 	for (int c = 0; c < r; ++c) 
-		printf("(%d*, %d, %d, %d*)+\n", r, x, f(3, c), f(1, c));
+		type(r, true, x, false, f(3, c), false, f(1, c), true, '+');
 	for (int a = 0; a <= r; ++a) 
 		for (int c = 0; c < r; ++c) 
-			printf("(%d, %d*, %d, %d)-\n", x, f(3, c), a, 0);
-	printf("\n");
+			type(x, false, f(3, c), true, a, false, 0, false, '-');
+	comment("\n");
 	
-	printf("# Middle - Step 3\n");
+	comment("# Middle - Step 3\n");
 	for (int c = 0; c < r; ++c) 
-		printf("(%d*, %d, %d, %d*)+\n", 0, f(4, c+1), x, f(1, c));
+		type(0, true, f(4, c+1), false, x, false, f(1, c), true, '+');
 	for (int a = 0; a <= r; ++a) 
 		for (int c = 0; c < r; ++c) 
-			printf("(%d, %d*, %d*, %d)-\n", c+1, a, f(4, c+1), x);
-	printf("\n");
+			type(c+1, false, a, true, f(4, c+1), true, x, false, '-');
+	comment("\n");
 
-	printf("\n");
+	comment("\n");
         
-        printf("# -------- Outer monomer types -------\n\n");
+        comment("# -------- Outer monomer types -------\n\n");
 
-	printf("# Outer - Step 1\n");
-	printf("(%d*, %d, %d, %d*)+\n", r, x, f(5, r), r);
+	comment("# Outer - Step 1\n");
+	type(r, true, x, false, f(5, r), false, r, true, '+');
 	for (int a = 0; a < r; ++a) 
-		printf("(%d, %d*, %d, %d*)-\n", x, f(5, r), a, f(6, a));
-	printf("\n");
+		type(x, false, f(5, r), true, a, false, f(6, a), true, '-');
+	comment("\n");
 
-	printf("# Outer - Step 2\n");
+	comment("# Outer - Step 2\n");
 	for (int a = 0; a < r; ++a) 
-		printf("(%d, %d*, %d, %d*)+\n", f(6, a), a+1, x, r);
+		type(f(6, a), false, a+1, true, x, false, r, true, '+');
 	for (int a = 0; a < r; ++a) 
-		printf("(%d, %d*, %d, %d)-\n", x, a, a+1, f(7, r));
-	printf("\n");
+		type(x, false, a, true, a+1, false, f(7, r), false, '-');
+	comment("\n");
 
-	printf("# Outer - Step 3\n");
+	comment("# Outer - Step 3\n");
 	for (int a = 0; a < r; ++a) 
-		printf("(%d*, %d, %d, %d*)+\n", f(7, r), x, f(8, r), f(6, a));
+		type(f(7, r), true, x, false, f(8, r), false, f(6, a), true, '+');
 	for (int a = 0; a < r; ++a) 
-		printf("(%d, %d*, %d, %d)-\n", x, f(8, r), a+1, 0);
-	printf("\n");
+		type(x, false, f(8, r), true, a+1, false, 0, false, '-');
+	comment("\n");
 
-	printf("# Outer - Step 4\n");
+	comment("# Outer - Step 4\n");
 	for (int a = 0; a < r; ++a) 
-		printf("(%d*, %d, %d, %d*)+\n", 0, f(9, a), x, f(6, a));
+		type(0, true, f(9, a), false, x, false, f(6, a), true, '+');
 	for (int a = 0; a < r; ++a) 
-		printf("(%d, %d*, %d*, %d)-\n", 0, a+1, f(9, a), x);
-	printf("\n");
+		type(0, false, a+1, true, f(9, a), true, x, false, '-');
+	comment("\n");
 
+	if (fflush(stdout) != 0 || ferror(stdout)) {
+		fprintf(stderr, "Cannot write output.\n");
+		return EXIT_FAILURE;
+	}
 	return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,53 @@
+/*
+Program for converting a grammar, pair grammar or insertion system
+from text to the binary format of binary.h, read by g2pg, pg2is and
+simulator in place of text.
+
+The program takes the kind of input as a command-line argument, "g"
+(grammar), "pg" (pair grammar) or "is" (insertion system), reads it
+from stdin and writes it to stdout in binary.
+*/
+
+#include "grammar.h"
+#include "insertionsystem.h"
+#include "pairgrammar.h"
+#include "parser.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char *argv[]) {
+	if (argc != 2 || (strcmp(argv[1], "g") != 0 && strcmp(argv[1], "pg") != 0 && strcmp(argv[1], "is") != 0)) {
+		fprintf(stderr, "Usage: tobinary g|pg|is < text > binary\n");
+		return EXIT_FAILURE;
+	}
+
+	Parser parser;
+	if (!parser.open(0)) {
+		fprintf(stderr, "Error: %s.\n", parser.error().c_str());
+		return EXIT_FAILURE;
+	}
+
+	bool ok;
+	if (strcmp(argv[1], "g") == 0) {
+		Grammar g;
+		ok = g.read(parser) && g.write_binary(stdout);
+	}
+	else if (strcmp(argv[1], "pg") == 0) {
+		PairGrammar pg;
+		ok = pg.read(parser) && pg.write_binary(stdout);
+	}
+	else {
+		InsertionSystem system;
+		ok = system.read(parser) && system.write_binary(stdout);
+	}
+
+	if (!ok) {
+		if (!parser.error().empty())
+			fprintf(stderr, "Error: %s.\n", parser.error().c_str());
+		else
+			fprintf(stderr, "Error: cannot write output.\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}